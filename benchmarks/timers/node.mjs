@@ -0,0 +1,13 @@
+const count = 1000000;
+const ids = new Array(count);
+
+for (let i = 0; i < count; i++) {
+    ids[i] = setTimeout(() => {}, 1000 + (i % 60000));
+}
+
+// keep every 1000th timer armed so the expiry path runs as well
+for (let i = 0; i < count; i++) {
+    if (i % 1000 !== 0) {
+        clearTimeout(ids[i]);
+    }
+}
@@ -0,0 +1,29 @@
+// Tick latency: how long it takes to run a burst of timers that all
+// expire within the same millisecond.
+const burst = 100000;
+const rounds = 20;
+const results = [];
+
+function round(n) {
+    if (n === rounds) {
+        results.sort((a, b) => a - b);
+        console.log("tick latency for " + burst + " timers (ms)");
+        console.log("  min " + results[0]);
+        console.log("  p50 " + results[Math.floor(rounds / 2)]);
+        console.log("  max " + results[rounds - 1]);
+        return;
+    }
+
+    let remaining = burst;
+    const start = Date.now();
+    for (let i = 0; i < burst; i++) {
+        setTimeout(() => {
+            if (--remaining === 0) {
+                results.push(Date.now() - start);
+                setImmediate(() => round(n + 1));
+            }
+        }, 1);
+    }
+}
+
+round(0);
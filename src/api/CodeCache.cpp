@@ -0,0 +1,166 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "CodeCache.hpp"
+#include <v8.h>
+#include "v8-script.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace Senkora::CodeCache {
+    typedef struct {
+        std::string path;
+        v8::Global<v8::UnboundModuleScript> script;
+    } Pending;
+
+    // modules compiled on this thread's isolate since the last Flush
+    thread_local std::vector<Pending> pending;
+
+    static const std::string& cacheDirectory() {
+        static const std::string dir = [] {
+            const char *enabled = getenv("SENKORA_CODE_CACHE");
+            if (enabled != nullptr && std::string(enabled) == "0") {
+                return std::string();
+            }
+
+            fs::path base;
+            if (const char *dir = getenv("SENKORA_CACHE_DIR")) {
+                base = dir;
+            } else if (const char *xdg = getenv("XDG_CACHE_HOME")) {
+                base = fs::path(xdg) / "senkora";
+            } else if (const char *home = getenv("HOME")) {
+                base = fs::path(home) / ".cache" / "senkora";
+            } else {
+                return std::string();
+            }
+
+            // caches of another V8 are rejected anyway, keep them apart
+            fs::path dir = base / (std::string("v8-") + v8::V8::GetVersion());
+            std::error_code err;
+            fs::create_directories(dir, err);
+            return err ? std::string() : dir.string();
+        }();
+
+        return dir;
+    }
+
+    // FNV-1a over the source, V8 checks the source itself before using
+    // an entry, so a collision costs a rejected cache and nothing else
+    static std::string entryPath(const std::string& code) {
+        const std::string& dir = cacheDirectory();
+        if (dir.empty()) {
+            return dir;
+        }
+
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : code) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+
+        char name[40];
+        snprintf(name, sizeof(name), "%016llx-%zx.bin", (unsigned long long) hash, code.size());
+        return dir + "/" + name;
+    }
+
+    std::unique_ptr<v8::ScriptCompiler::CachedData> Load(const std::string& code) {
+        std::string path = entryPath(code);
+        if (path.empty()) {
+            return nullptr;
+        }
+
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.good()) {
+            return nullptr;
+        }
+
+        std::streamsize size = file.tellg();
+        if (size <= 0 || size > INT32_MAX) {
+            return nullptr;
+        }
+
+        uint8_t *data = new uint8_t[size];
+        file.seekg(0);
+        if (!file.read((char *) data, size)) {
+            delete[] data;
+            return nullptr;
+        }
+
+        return std::make_unique<v8::ScriptCompiler::CachedData>(data, (int) size, v8::ScriptCompiler::CachedData::BufferOwned);
+    }
+
+    void Add(v8::Isolate *isolate, const std::string& code, v8::Local<v8::Module> mod) {
+        std::string path = entryPath(code);
+        if (path.empty()) {
+            return;
+        }
+
+        pending.push_back({ path, v8::Global<v8::UnboundModuleScript>(isolate, mod->GetUnboundModuleScript()) });
+    }
+
+    void Reject(const std::string& code) {
+        std::string path = entryPath(code);
+        if (!path.empty()) {
+            unlink(path.c_str());
+        }
+    }
+
+    void Flush(v8::Isolate *isolate) {
+        std::vector<Pending> scripts = std::move(pending);
+        pending.clear();
+
+        // a terminated worker can't produce anything anymore
+        if (isolate->IsExecutionTerminating()) {
+            return;
+        }
+
+        v8::HandleScope handleScope(isolate);
+
+        for (auto& entry : scripts) {
+            std::unique_ptr<v8::ScriptCompiler::CachedData> cache(v8::ScriptCompiler::CreateCodeCache(entry.script.Get(isolate)));
+            entry.script.Reset();
+            if (!cache || cache->length <= 0) {
+                continue;
+            }
+
+            // other runs may read the entry meanwhile, it only ever appears whole
+            std::string temp = entry.path + "." + std::to_string(gettid()) + ".tmp";
+            {
+                std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+                file.write((const char *) cache->data, cache->length);
+                if (!file.good()) {
+                    file.close();
+                    unlink(temp.c_str());
+                    continue;
+                }
+            }
+
+            if (rename(temp.c_str(), entry.path.c_str()) != 0) {
+                unlink(temp.c_str());
+            }
+        }
+    }
+}
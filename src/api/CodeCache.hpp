@@ -0,0 +1,46 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SENKORA_CODE_CACHE
+#define SENKORA_CODE_CACHE
+
+#include <v8-isolate.h>
+#include <v8-local-handle.h>
+#include <v8-script.h>
+#include <memory>
+#include <string>
+
+// V8 code cache for user modules, kept on disk between runs. Entries are
+// keyed by a hash of the source and live in a directory per V8 version:
+// $SENKORA_CACHE_DIR, else $XDG_CACHE_HOME/senkora or ~/.cache/senkora.
+// SENKORA_CODE_CACHE=0 turns it off.
+namespace Senkora::CodeCache {
+    // the stored cache for `code`, nullptr when there is none
+    std::unique_ptr<v8::ScriptCompiler::CachedData> Load(const std::string& code);
+
+    // `mod` compiled without a usable cache, its cache is written by Flush
+    void Add(v8::Isolate *isolate, const std::string& code, v8::Local<v8::Module> mod);
+
+    // V8 refused the stored cache (flags, version, corruption), drop it
+    void Reject(const std::string& code);
+
+    // Writes the caches of the modules added since the last call. Run after
+    // evaluation, the functions compiled on the way are cached as well.
+    void Flush(v8::Isolate *isolate);
+}
+
+#endif
@@ -27,6 +27,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "v8-message.h"
 #include "v8-value.h"
 #include <ObjectBuilder.hpp>
+#include "CodeCache.hpp"
 #include <cstdio>
 #include <cstring>
 #include <functional>
@@ -36,7 +37,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <fstream>
 #include <filesystem>
 
-extern const Senkora::SharedGlobals globals;
+extern thread_local const Senkora::SharedGlobals globals;
 
 using Senkora::Object::ObjectBuilder;
 namespace fs = std::filesystem;
@@ -101,12 +102,25 @@ namespace Senkora
                 0, 0, false, globals.lastScriptId, v8::Local<v8::Value>(), false, false, true);
         globals.lastScriptId++;
 
-        v8::ScriptCompiler::Source source(v8::String::NewFromUtf8(isolate, code.c_str()).ToLocalChecked(), origin);
+        // the source takes ownership of the cache
+        std::unique_ptr<v8::ScriptCompiler::CachedData> cache = CodeCache::Load(code);
+        v8::ScriptCompiler::CompileOptions options = cache ? v8::ScriptCompiler::kConsumeCodeCache : v8::ScriptCompiler::kNoCompileOptions;
+        v8::ScriptCompiler::Source source(v8::String::NewFromUtf8(isolate, code.c_str()).ToLocalChecked(), origin, cache.release());
         {
             v8::TryCatch tryCatch(isolate);
-            v8::MaybeLocal<v8::Module> ret = v8::ScriptCompiler::CompileModule(isolate, &source);
+            v8::MaybeLocal<v8::Module> ret = v8::ScriptCompiler::CompileModule(isolate, &source, options);
             if (tryCatch.HasCaught()) {
                 Senkora::printException(ctx, tryCatch.Exception());
+                return ret;
+            }
+
+            // a rejected cache was compiled from source, the new one replaces it
+            bool rejected = options == v8::ScriptCompiler::kConsumeCodeCache && source.GetCachedData()->rejected;
+            if (rejected) {
+                CodeCache::Reject(code);
+            }
+            if (!ret.IsEmpty() && (options != v8::ScriptCompiler::kConsumeCodeCache || rejected)) {
+                CodeCache::Add(isolate, code, ret.ToLocalChecked());
             }
             return ret;
         }
@@ -250,4 +264,20 @@ namespace Senkora
         v8::Local<v8::Value> exc = throwException(ctx, message, type);
         printException(ctx, exc);
     }
+
+    // the tags are the addresses of these, aligned the way V8 wants
+    static const int nativeTags[(int) NativeType::NATIVE_TYPES] = {};
+
+    void setNativePointer(v8::Local<v8::Object> object, NativeType type, void *pointer) {
+        object->SetAlignedPointerInInternalField(0, (void *) &nativeTags[(int) type]);
+        object->SetAlignedPointerInInternalField(1, pointer);
+    }
+
+    void *getNativePointer(v8::Local<v8::Object> object, NativeType type) {
+        if (object->InternalFieldCount() < NATIVE_FIELD_COUNT || object->GetAlignedPointerFromInternalField(0) != &nativeTags[(int) type]) {
+            return nullptr;
+        }
+
+        return object->GetAlignedPointerFromInternalField(1);
+    }
 }
@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "../eventLoop.hpp"
 #include "v8-exception.h"
 #include "v8-local-handle.h"
+#include "v8-object.h"
 #include "v8-primitive.h"
 #include <map>
 #include <v8-context.h>
@@ -44,6 +45,19 @@ namespace Senkora {
         ERROR
     };
 
+    // Objects backed by a native struct hold its type in internal field 0
+    // and the pointer in field 1. A method called on another kind of native
+    // object (watcher.close.call(file)) gets nullptr, not the wrong struct.
+    enum class NativeType {
+        FILE_HANDLE,
+        ASYNC_ITERATOR,
+        PATH_WATCHER,
+        WORKER,
+        NATIVE_TYPES
+    };
+
+    constexpr int NATIVE_FIELD_COUNT = 2;
+
     class MetadataObject {
         private:
             std::map<std::string_view, Metadata> meta;
@@ -56,7 +70,6 @@ namespace Senkora {
 
     typedef struct {
         mutable int lastScriptId = 0;
-        mutable int restId = 1;
         mutable std::map<int, std::unique_ptr<MetadataObject>> moduleMetadatas;
         mutable std::map<std::string_view, v8::Local<v8::Module>> moduleCache;
         mutable std::unique_ptr<events::EventLoop> globalLoop = events::Init();
@@ -73,5 +86,10 @@ namespace Senkora {
     void printException(v8::Local<v8::Context> ctx, v8::Local<v8::Value> exception);
 
     void throwAndPrintException(v8::Local<v8::Context> ctx, const char* message, ExceptionType type = ExceptionType::ERROR);
+
+    // `object` comes from a template with NATIVE_FIELD_COUNT internal fields
+    void setNativePointer(v8::Local<v8::Object> object, NativeType type, void *pointer);
+    // nullptr unless `object` was tagged with `type`
+    void *getNativePointer(v8::Local<v8::Object> object, NativeType type);
 }
 #endif
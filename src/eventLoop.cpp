@@ -21,94 +21,461 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "v8-object.h"
 #include <cstdint>
 #include <v8-exception.h>
-#include <event.hpp>
-#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
 #include <memory>
 
 #include "Senkora.hpp"
 #include "eventLoop.hpp"
 #include "v8-context.h"
 
-extern const Senkora::SharedGlobals globals;
+extern thread_local const Senkora::SharedGlobals globals;
 
 namespace events {
     std::unique_ptr<EventLoop> Init() {
         auto loop = std::make_unique<EventLoop>();
-        loop->immediate = std::make_unique<foxevents::FoxEventQueue>();
-        loop->rest = std::make_unique<foxevents::FoxEventQueue>();
-        loop->data = std::vector<std::unique_ptr<EventLoopData>>();
-        loop->restCache = std::vector<std::unique_ptr<foxevents::FoxEvent>>();
-        loop->immediateCache = std::vector<std::unique_ptr<foxevents::FoxEvent>>();
+        loop->timers = std::make_unique<TimerWheel>(getTimeInMs());
+        loop->pendingImmediates = 0;
+        loop->refs = 0;
+        loop->isolate = nullptr;
+        loop->stopped = false;
+        loop->idleDone = false;
+        loop->pressure = v8::MemoryPressureLevel::kNone;
+        loop->lastRssCheck = 0;
+
+        loop->pollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = loop->timerFd;
+        epoll_ctl(loop->pollFd, EPOLL_CTL_ADD, loop->timerFd, &ev);
+
+        // not referenced, pendingWork is what keeps the loop alive
+        loop->pendingWork = 0;
+        loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        Watch(loop.get(), loop->wakeFd, EPOLLIN, RunCompletions, loop.get(), false);
+
+        loop->uringProbed = false;
 
         return loop;
     }
 
+    // Microtasks run once after every macrotask batch, so promise
+    // continuations interleave the same way on every run.
     void Run(EventLoop* const& loop) {
-        while (HasEvents(loop)) {
+        Checkpoint(loop);
+        while (!loop->stopped && HasEvents(loop)) {
+            uint64_t start = getTimeInNs();
+            loop->stats.tickIdle = 0;
+
+            RunImmediates(loop);
+            Checkpoint(loop);
+            RunTimers(loop);
+            Checkpoint(loop);
+            RunTasks(loop);
+            Poll(loop);
+            Checkpoint(loop);
+
+            // only the time spent doing work counts towards the tick
+            uint64_t busy = getTimeInNs() - start - loop->stats.tickIdle;
+            loop->stats.tickDuration.Record(busy / 1000);
+            loop->stats.ticks++;
+        }
+    }
+
+    void Stop(EventLoop* const& loop) {
+        loop->stopped = true;
+    }
+
+    // Drops whatever is still scheduled, waits for the thread pool and the
+    // ring to hand back their requests and closes the loop's fds. Only
+    // loops that go away before the process does (workers) need this.
+    void Shutdown(EventLoop* const& loop) {
+        loop->timers = std::make_unique<TimerWheel>(getTimeInMs());
+        loop->immediates.clear();
+        loop->pendingImmediates = 0;
+        loop->tasks = TaskQueue();
+
+        while (loop->pendingWork > 0) {
+            Poll(loop);
+        }
+
+        for (auto& [fd, watcher] : loop->watchers) {
+            epoll_ctl(loop->pollFd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        loop->watchers.clear();
+        loop->refs = 0;
+
+        loop->uring.reset();
+        close(loop->wakeFd);
+        close(loop->timerFd);
+        close(loop->pollFd);
+    }
+
+    void Checkpoint(EventLoop* const& loop) {
+        if (loop->isolate != nullptr) {
+            loop->isolate->PerformMicrotaskCheckpoint();
+        }
+    }
+
+    // Runs the immediates that were queued before this tick,
+    // the ones they queue themselves wait for the next one.
+    void RunImmediates(EventLoop* const& loop) {
+        if (loop->pendingImmediates == 0) {
+            loop->immediates.clear();
+            return;
+        }
+
+        loop->immediates.swap(loop->immediateBatch);
+
+        v8::Isolate *isolate = loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope scope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        for (uint64_t id : loop->immediateBatch) {
+            EventLoopData *data = loop->pool.Get(id);
+            if (data == nullptr) {
+                continue;
+            }
+
+            loop->pendingImmediates--;
+            executionFunc(loop, ctx, data);
+        }
+
+        loop->immediateBatch.clear();
+    }
+
+    void RunTimers(EventLoop* const& loop) {
+        if (loop->timers->Empty()) {
+            return;
+        }
+
+        uint64_t now = getTimeInMs();
+        loop->timers->Advance(now, loop->expired);
+        if (loop->expired.empty()) {
+            return;
+        }
+
+        // one set of scopes for everything due this tick
+        v8::Isolate *isolate = loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope scope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        for (uint64_t id : loop->expired) {
+            // cleared by an earlier callback of this batch
+            EventLoopData *data = loop->pool.Get(id);
+            if (data == nullptr) {
+                continue;
+            }
+
+            loop->stats.lag.Record(now - data->node.expires);
+
+            if (data->repeat) {
+                loop->timers->Insert(&data->node, now + data->interval);
+            }
+            executionFunc(loop, ctx, data);
+        }
+
+        loop->expired.clear();
+    }
+
+    // Blocks until the next timer is due or a watched fd becomes ready.
+    // Pending immediates make this a non-blocking check of the fds.
+    void Poll(EventLoop* const& loop) {
+        if (!HasEvents(loop)) {
+            return;
+        }
+
+        int timeout = -1;
+        struct itimerspec spec = {};
+
+        if (loop->pendingImmediates > 0 || !loop->tasks.Empty()) {
+            timeout = 0;
+        } else if (!loop->timers->Empty()) {
+            uint64_t deadline = NextDeadline(loop);
             uint64_t now = getTimeInMs();
-            if (!loop->immediate->empty()) {
-                loop->immediate->run(now);
+
+            if (deadline <= now) {
+                timeout = 0;
+            } else {
+                uint64_t wait = deadline - now;
+                spec.it_value.tv_sec = (time_t) (wait / 1000);
+                spec.it_value.tv_nsec = (long) (wait % 1000) * 1000000;
+            }
+        }
+
+        timerfd_settime(loop->timerFd, 0, &spec, nullptr);
+
+        // everything queued on the ring during this tick goes in one syscall
+        if (loop->uring) {
+            loop->uring->Submit();
+        }
+
+        Idle(loop, timeout);
+
+        struct epoll_event events[64];
+        uint64_t waitStart = getTimeInNs();
+        int count = epoll_wait(loop->pollFd, events, 64, timeout);
+        uint64_t waited = getTimeInNs() - waitStart;
+        loop->stats.tickIdle += waited;
+        loop->stats.idleTime += waited;
+
+        // new work came in, the GC may have something to do again
+        if (count > 0) {
+            loop->idleDone = false;
+        }
+
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == loop->timerFd) {
+                uint64_t expirations;
+                [[maybe_unused]] ssize_t _ = read(loop->timerFd, &expirations, sizeof(expirations));
+                continue;
             }
-            if (!loop->rest->empty()) {
-                loop->rest->run(now);
+
+            // look the watcher up again, an earlier callback may have removed it
+            auto it = loop->watchers.find(fd);
+            if (it == loop->watchers.end()) {
+                continue;
             }
+
+            Watcher *watcher = it->second.get();
+            watcher->callback(fd, events[i].events, watcher->data);
         }
     }
 
-    void Add(EventLoop* const& loop, foxevents::FoxEvent* const& event) {
-        loop->rest->add(event);
+    bool Watch(EventLoop* const& loop, int fd, uint32_t events, WatchCallback callback, void *data, bool ref) {
+        struct epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+
+        if (epoll_ctl(loop->pollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            return false;
+        }
+
+        auto watcher = std::make_unique<Watcher>();
+        watcher->fd = fd;
+        watcher->callback = callback;
+        watcher->data = data;
+        watcher->ref = ref;
+
+        if (ref) {
+            loop->refs++;
+        }
+        loop->watchers[fd] = std::move(watcher);
+
+        return true;
     }
 
-    void AddImmediate(EventLoop* const& loop, foxevents::FoxEvent* const& event) {
-        loop->immediate->add(event);
+    void Unwatch(EventLoop* const& loop, int fd) {
+        auto it = loop->watchers.find(fd);
+        if (it == loop->watchers.end()) {
+            return;
+        }
+
+        epoll_ctl(loop->pollFd, EPOLL_CTL_DEL, fd, nullptr);
+        if (it->second->ref) {
+            loop->refs--;
+        }
+        loop->watchers.erase(it);
+    }
+
+    void SetRef(EventLoop* const& loop, int fd, bool ref) {
+        auto it = loop->watchers.find(fd);
+        if (it == loop->watchers.end() || it->second->ref == ref) {
+            return;
+        }
+
+        it->second->ref = ref;
+        loop->refs += ref ? 1 : -1;
     }
 
-    void Remove(EventLoop* const& loop, int id) {
-        loop->rest->remove_id(id);
-        size_t length = globals.globalLoop->restCache.size();
-        for (int i = 0; i < length; i++) {
-            if (globals.globalLoop->restCache[i]->id == id) {
-                globals.globalLoop->restCache.erase(globals.globalLoop->restCache.begin() + i);
-                break;
+    void QueueWork(EventLoop* const& loop, std::function<void()> work, std::function<void(v8::Local<v8::Context>)> after) {
+        auto item = std::make_shared<Work>();
+        item->work = std::move(work);
+        item->after = std::move(after);
+        loop->pendingWork++;
+
+        EventLoop *target = loop;
+        GetThreadPool().Submit([target, item] {
+            item->work();
+
+            {
+                std::lock_guard<std::mutex> lock(target->completedMutex);
+                target->completed.push_back(item);
             }
+
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t _ = write(target->wakeFd, &one, sizeof(one));
+        });
+    }
+
+    v8::Local<v8::Promise> QueueWorkPromise(
+        EventLoop* const& loop,
+        v8::Local<v8::Context> ctx,
+        std::function<void()> work,
+        std::function<void(v8::Local<v8::Context>, v8::Local<v8::Promise::Resolver>)> settle
+    ) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(ctx).ToLocalChecked();
+        auto handle = std::make_shared<v8::Global<v8::Promise::Resolver>>(isolate, resolver);
+
+        QueueWork(loop, std::move(work), [handle, settle = std::move(settle)](v8::Local<v8::Context> ctx) {
+            v8::Local<v8::Promise::Resolver> resolver = handle->Get(ctx->GetIsolate());
+            handle->Reset();
+            settle(ctx, resolver);
+        });
+
+        return resolver->GetPromise();
+    }
+
+    void RunCompletions([[maybe_unused]] int fd, [[maybe_unused]] uint32_t events, void *data) {
+        auto loop = (EventLoop *) data;
+
+        uint64_t count;
+        [[maybe_unused]] ssize_t _ = read(loop->wakeFd, &count, sizeof(count));
+
+        {
+            std::lock_guard<std::mutex> lock(loop->completedMutex);
+            loop->completed.swap(loop->completedBatch);
         }
-        size_t length2 = globals.globalLoop->data.size();
-        for (int i = 0; i < length2; i++) {
-            if (globals.globalLoop->data[i]->id == id) {
-                globals.globalLoop->data.erase(globals.globalLoop->data.begin() + i);
-                break;
+
+        if (loop->completedBatch.empty()) {
+            return;
+        }
+
+        v8::Isolate *isolate = loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope scope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        for (auto& item : loop->completedBatch) {
+            loop->pendingWork--;
+
+            v8::TryCatch tryCatch(isolate);
+            item->after(ctx);
+            if (tryCatch.HasCaught()) {
+                Senkora::printException(ctx, tryCatch.Exception());
             }
         }
+
+        loop->completedBatch.clear();
     }
 
-    void RemoveImmediate(EventLoop* const& loop, int id) {
-        loop->immediate->remove_id(id);
-        
-        size_t length = globals.globalLoop->immediateCache.size();
-        for (int i = 0; i < length; i++) {
-            if (globals.globalLoop->immediateCache[i]->id == id) {
-                globals.globalLoop->immediateCache.erase(globals.globalLoop->immediateCache.begin() + i);
-                break;
+    Uring *ReserveUring(EventLoop* const& loop) {
+        if (!loop->uringProbed) {
+            loop->uringProbed = true;
+            loop->uring = Uring::Create(256);
+            if (loop->uring && !Watch(loop, loop->uring->Fd(), EPOLLIN, ReapUring, loop, false)) {
+                loop->uring.reset();
             }
         }
-        size_t length2 = globals.globalLoop->data.size();
-        for (int i = 0; i < length2; i++) {
-            if (globals.globalLoop->data[i]->id == id) {
-                globals.globalLoop->data.erase(globals.globalLoop->data.begin() + i);
-                break;
+
+        if (!loop->uring || !loop->uring->Reserve()) {
+            return nullptr;
+        }
+
+        loop->pendingWork++;
+        return loop->uring.get();
+    }
+
+    void FinishUring(EventLoop* const& loop) {
+        loop->uring->Release();
+        loop->pendingWork--;
+    }
+
+    void ReapUring([[maybe_unused]] int fd, [[maybe_unused]] uint32_t events, void *data) {
+        auto loop = (EventLoop *) data;
+
+        v8::Isolate *isolate = loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope scope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        loop->uring->Reap([&](UringRequest *request, int res) {
+            v8::TryCatch tryCatch(isolate);
+            if (!request->Complete(ctx, res)) {
+                delete request;
+                FinishUring(loop);
             }
+
+            if (tryCatch.HasCaught()) {
+                Senkora::printException(ctx, tryCatch.Exception());
+            }
+        });
+    }
+
+    void Add(EventLoop* const& loop, EventLoopData *data, uint64_t timeout) {
+        loop->timers->Insert(&data->node, getTimeInMs() + timeout);
+    }
+
+    void AddImmediate(EventLoop* const& loop, EventLoopData *data) {
+        loop->immediates.push_back(data->id);
+        loop->pendingImmediates++;
+    }
+
+    void Remove(EventLoop* const& loop, uint64_t id) {
+        EventLoopData *data = loop->pool.Get(id);
+        if (data == nullptr || data->immediate) {
+            return;
+        }
+
+        loop->timers->Remove(&data->node);
+        loop->pool.Release(data);
+    }
+
+    void RemoveImmediate(EventLoop* const& loop, uint64_t id) {
+        EventLoopData *data = loop->pool.Get(id);
+        if (data == nullptr || !data->immediate) {
+            return;
         }
+
+        loop->pendingImmediates--;
+        loop->pool.Release(data);
     }
 
     bool HasEvents(EventLoop* const& loop) {
-        return !loop->immediate->empty() || !loop->rest->empty();
+        return loop->pendingImmediates > 0 || !loop->timers->Empty() || !loop->tasks.Empty() || loop->refs > 0 || loop->pendingWork > 0;
+    }
+
+    uint64_t NextDeadline(EventLoop* const& loop) {
+        return loop->timers->NextExpiry();
     }
 
     uint64_t getTimeInMs() {
-        struct timeval tv;
-        gettimeofday(&tv, nullptr);
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
 
-        return (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+        return ((uint64_t) ts.tv_sec * 1000) + ((uint64_t) ts.tv_nsec / 1000000);
+    }
+
+    static EventLoopData *newEventLoopData(const v8::FunctionCallbackInfo<v8::Value> &args) {
+        v8::Isolate *isolate = args.GetIsolate();
+
+        EventLoopData *funcArgs = globals.globalLoop->pool.Acquire();
+        if (funcArgs == nullptr) {
+            Senkora::throwException(isolate->GetCurrentContext(), "Too many pending timers", Senkora::ExceptionType::RANGE);
+            return nullptr;
+        }
+
+        funcArgs->callback.Reset(isolate, args[0]);
+        funcArgs->global.Reset(isolate, args.This());
+        funcArgs->interval = 0;
+        funcArgs->repeat = false;
+        funcArgs->immediate = false;
+
+        return funcArgs;
     }
 
     void setTimeout(const v8::FunctionCallbackInfo<v8::Value> &args) {
@@ -118,31 +485,31 @@ namespace events {
 
         if (args.Length() < 2) {
             Senkora::throwException(ctx, "setTimeout requires at least 2 arguments");
+            return;
         }
 
         if (!args[0]->IsFunction()) {
             Senkora::throwException(ctx, "setTimeout requires a function as the first argument");
+            return;
         }
 
         if (!args[1]->IsNumber()) {
             Senkora::throwException(ctx, "setTimeout requires a number as the second argument");
+            return;
         }
 
-        v8::Handle<v8::Value> callback(args[0]);
         long timeout = args[1]->IntegerValue(isolate->GetCurrentContext()).ToChecked();
+        if (timeout < 0) {
+            timeout = 0;
+        }
 
-        auto funcArgs = std::make_unique<EventLoopData>();
-        funcArgs->callback.Reset(isolate, callback);
-        funcArgs->global.Reset(isolate, args.This());
-        funcArgs->isolate = isolate;
-        funcArgs->id = globals.restId;
+        EventLoopData *funcArgs = newEventLoopData(args);
+        if (funcArgs == nullptr) {
+            return;
+        }
 
-        auto event = std::make_unique<foxevents::FoxEvent>(timeout, false, executionFunc, funcArgs.get(), globals.restId);
-        args.GetReturnValue().Set(v8::Integer::New(isolate, event->id));
-        Add(globals.globalLoop.get(), event.get());
-        globals.globalLoop->data.push_back(std::move(funcArgs));
-        globals.globalLoop->restCache.push_back(std::move(event));
-        globals.restId++;
+        args.GetReturnValue().Set(v8::Number::New(isolate, (double) funcArgs->id));
+        Add(globals.globalLoop.get(), funcArgs, (uint64_t) timeout);
     }
 
     void setImmediate(const v8::FunctionCallbackInfo<v8::Value> &args) {
@@ -152,27 +519,22 @@ namespace events {
 
         if (args.Length() < 1) {
             Senkora::throwException(ctx, "setImmediate requires at least 1 argument");
+            return;
         }
 
         if (!args[0]->IsFunction()) {
             Senkora::throwException(ctx, "setImmediate requires a function as the first argument");
+            return;
         }
 
-        v8::Handle<v8::Value> callback(args[0]);
-
-        auto funcArgs = std::make_unique<EventLoopData>();
-        funcArgs->callback.Reset(isolate, callback);
-        funcArgs->global.Reset(isolate, args.This());
-        funcArgs->isolate = isolate;
-        funcArgs->id = globals.restId;
-
-        auto event = std::make_unique<foxevents::FoxEvent>(0, false, executionFunc, funcArgs.get(), globals.restId);
-        args.GetReturnValue().Set(v8::Integer::New(isolate, event->id));
-        AddImmediate(globals.globalLoop.get(), event.get());
-        globals.globalLoop->data.push_back(std::move(funcArgs));
-        globals.globalLoop->immediateCache.push_back(std::move(event));
+        EventLoopData *funcArgs = newEventLoopData(args);
+        if (funcArgs == nullptr) {
+            return;
+        }
 
-        globals.restId++;
+        funcArgs->immediate = true;
+        args.GetReturnValue().Set(v8::Number::New(isolate, (double) funcArgs->id));
+        AddImmediate(globals.globalLoop.get(), funcArgs);
     }
 
     void setInterval(const v8::FunctionCallbackInfo<v8::Value> &args) {
@@ -182,31 +544,34 @@ namespace events {
 
         if (args.Length() < 2) {
             Senkora::throwException(ctx, "setInterval requires at least 2 arguments");
+            return;
         }
 
         if (!args[0]->IsFunction()) {
             Senkora::throwException(ctx, "setInterval requires a function as the first argument");
+            return;
         }
 
         if (!args[1]->IsNumber()) {
             Senkora::throwException(ctx, "setInterval requires a number as the second argument");
+            return;
         }
 
-        v8::Handle<v8::Value> callback(args[0]);
         long timeout = args[1]->IntegerValue(isolate->GetCurrentContext()).ToChecked();
+        // a zero interval would re-expire within the same tick forever
+        if (timeout < 1) {
+            timeout = 1;
+        }
 
-        auto funcArgs = std::make_unique<EventLoopData>();
-        funcArgs->callback.Reset(isolate, callback);
-        funcArgs->global.Reset(isolate, args.This());
-        funcArgs->isolate = isolate;
-        funcArgs->id = globals.restId;
+        EventLoopData *funcArgs = newEventLoopData(args);
+        if (funcArgs == nullptr) {
+            return;
+        }
 
-        auto event = std::make_unique<foxevents::FoxEvent>(timeout, true, executionFunc, funcArgs.get(), globals.restId);
-        args.GetReturnValue().Set(v8::Integer::New(isolate, event->id));
-        Add(globals.globalLoop.get(), event.get());
-        globals.globalLoop->restCache.push_back(std::move(event));
-        globals.globalLoop->data.push_back(std::move(funcArgs));
-        globals.restId++;
+        funcArgs->interval = (uint64_t) timeout;
+        funcArgs->repeat = true;
+        args.GetReturnValue().Set(v8::Number::New(isolate, (double) funcArgs->id));
+        Add(globals.globalLoop.get(), funcArgs, (uint64_t) timeout);
     }
 
     void clearInterval(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -223,7 +588,7 @@ namespace events {
         }
 
         long id = args[0]->IntegerValue(isolate->GetCurrentContext()).ToChecked();
-        Remove(globals.globalLoop.get(), (int) id);
+        Remove(globals.globalLoop.get(), (uint64_t) id);
     }
 
     void clearTimeout(const v8::FunctionCallbackInfo<v8::Value>& args) {
@@ -240,7 +605,7 @@ namespace events {
         }
 
         long id = args[0]->IntegerValue(isolate->GetCurrentContext()).ToChecked();
-        Remove(globals.globalLoop.get(), (int) id);
+        Remove(globals.globalLoop.get(), (uint64_t) id);
     }
 
     void clearImmediate(const v8::FunctionCallbackInfo<v8::Value> &args) {
@@ -257,24 +622,50 @@ namespace events {
         }
 
         long id = args[0]->IntegerValue(isolate->GetCurrentContext()).ToChecked();
-        RemoveImmediate(globals.globalLoop.get(), (int) id);
+        RemoveImmediate(globals.globalLoop.get(), (uint64_t) id);
     }
 
-    void executionFunc(void *args) {
-        auto funcArgs = (EventLoopData *) args;
-        v8::Isolate *isolation = funcArgs->isolate;
-        v8::Isolate::Scope isolateScope(isolation);
-        v8::HandleScope scope(isolation);
-        v8::Local<v8::Context> ctx = isolation->GetCurrentContext();
-        v8::Context::Scope contextScope(ctx);
+    void queueMicrotask(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::HandleScope scope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "queueMicrotask requires at least 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsFunction()) {
+            Senkora::throwException(ctx, "queueMicrotask requires a function as the first argument", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        isolate->EnqueueMicrotask(args[0].As<v8::Function>());
+    }
+
+    // Expects the caller to have entered the isolate and `ctx`,
+    // only the exception handling is per callback.
+    void executionFunc(EventLoop* const& loop, v8::Local<v8::Context> ctx, EventLoopData *funcArgs) {
+        v8::Isolate *isolation = loop->isolate;
 
         v8::Local<v8::Value> preFunc = funcArgs->callback.Get(isolation);
         v8::Local<v8::Object> global = funcArgs->global.Get(isolation);
 
+        // one-shot records go back to the pool before the call, the locals
+        // keep the closure alive until it returns and nothing after that
+        if (!funcArgs->repeat) {
+            loop->pool.Release(funcArgs);
+        }
+
         v8::Local<v8::Function> func = v8::Local<v8::Function>::Cast(preFunc);
         v8::TryCatch tryCatch(isolation);
         v8::MaybeLocal<v8::Value> result = func->Call(ctx, global, 0, nullptr);
 
+        // a terminated worker, there is no exception to print
+        if (tryCatch.HasTerminated()) {
+            return;
+        }
+
         if (tryCatch.HasCaught() || result.IsEmpty()) {
             Senkora::printException(ctx, tryCatch.Exception());
         }
@@ -22,12 +22,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "v8-object.h"
 #include "v8-persistent-handle.h"
 #include "v8-value.h"
+#include "timerWheel.hpp"
+#include "loopStats.hpp"
+#include "threadPool.hpp"
+#include "uring.hpp"
+#include "scheduler.hpp"
+#include "v8-promise.h"
 #include <any>
 #include <cstdint>
+#include <functional>
+#include <mutex>
 #include <v8-local-handle.h>
 #include <v8.h>
-#include <event.hpp>
 #include <vector>
+#include <map>
 #include <memory>
 
 namespace events {
@@ -35,26 +43,142 @@ namespace events {
     typedef struct {
         v8::Persistent<v8::Value> callback;
         v8::Persistent<v8::Object> global;
-        v8::Isolate *isolate;
-        int id;
+        uint64_t id;
+        uint64_t interval;
+        bool repeat;
+        bool immediate;
+        TimerNode node;
+        // slot in the pool and how many times it has been reused
+        uint32_t index;
+        uint32_t generation;
     } EventLoopData;
 
+    // Slab of timer records, recycled as soon as a timer fires or is cleared.
+    // Ids carry the generation of the slot, so a stale id from a recycled
+    // record is recognised instead of clearing whatever reused the slot.
+    class TimerPool {
+        public:
+            TimerPool() = default;
+            TimerPool(const TimerPool&) = delete;
+            TimerPool& operator=(const TimerPool&) = delete;
+
+            // nullptr when every index is taken
+            EventLoopData *Acquire();
+            // nullptr for ids of records that have been released since
+            EventLoopData *Get(uint64_t id);
+            void Release(EventLoopData *data);
+
+            size_t Size() const { return this->live; }
+
+        private:
+            static constexpr int INDEX_BITS = 24;
+            static constexpr int CHUNK_BITS = 10;
+            static constexpr uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+            // ids are handed to JS as numbers, keep them within 2^53
+            static constexpr uint32_t MAX_GENERATION = (1 << (53 - INDEX_BITS)) - 1;
+
+            EventLoopData *At(uint32_t index);
+
+            std::vector<std::unique_ptr<EventLoopData[]>> chunks;
+            std::vector<uint32_t> freeList;
+            uint32_t allocated = 0;
+            size_t live = 0;
+    };
+
+    // called from Run when `fd` reports any of the epoll events it was registered with
+    typedef void (*WatchCallback)(int fd, uint32_t events, void *data);
+
     typedef struct {
-        std::unique_ptr<foxevents::FoxEventQueue> immediate;
-        std::unique_ptr<foxevents::FoxEventQueue> rest;
-        std::vector<std::unique_ptr<foxevents::FoxEvent>> immediateCache;
-        std::vector<std::unique_ptr<foxevents::FoxEvent>> restCache;
-        std::vector<std::unique_ptr<EventLoopData>> data;
+        int fd;
+        WatchCallback callback;
+        void *data;
+        // referenced watchers keep Run alive, unreferenced ones are only serviced
+        bool ref;
+    } Watcher;
+
+    // `work` runs on the thread pool, `after` back on the loop thread
+    // inside the isolate and context of the loop
+    typedef struct {
+        std::function<void()> work;
+        std::function<void(v8::Local<v8::Context>)> after;
+    } Work;
+
+    typedef struct {
+        std::unique_ptr<TimerWheel> timers;
+        TimerPool pool;
+        // ids in scheduling order, cleared ones are skipped when they come up
+        std::vector<uint64_t> immediates;
+        std::vector<uint64_t> immediateBatch;
+        size_t pendingImmediates;
+        std::vector<uint64_t> expired;
+        // scheduler.postTask / scheduler.yield
+        TaskQueue tasks;
+        std::map<int, std::unique_ptr<Watcher>> watchers;
+        int refs;
+        int pollFd;
+        int timerFd;
+        // pool threads push finished work here and poke wakeFd
+        int wakeFd;
+        std::mutex completedMutex;
+        std::vector<std::shared_ptr<Work>> completed;
+        std::vector<std::shared_ptr<Work>> completedBatch;
+        size_t pendingWork;
+        // created on first use, stays null where io_uring isn't available
+        std::unique_ptr<Uring> uring;
+        bool uringProbed;
+        // set once the isolate is entered, microtasks are checkpointed on it
+        v8::Isolate *isolate;
+        // set by Stop, Run returns at the end of the current tick
+        bool stopped;
+        // the GC reported it had nothing left to do in idle time
+        bool idleDone;
+        v8::MemoryPressureLevel pressure;
+        uint64_t lastRssCheck;
+        LoopStats stats;
     } EventLoop;
 
     std::unique_ptr<EventLoop> Init();
 
     void Run(EventLoop* const& loop);
-    void Add(EventLoop* const& loop, foxevents::FoxEvent* const& event);
-    void AddImmediate(EventLoop* const& loop, foxevents::FoxEvent* const& eventt);
-    void Remove(EventLoop* const& loop, int id);
-    void RemoveImmediate(EventLoop* const& loop, int id);
+    void Stop(EventLoop* const& loop);
+    void Shutdown(EventLoop* const& loop);
+    void RunImmediates(EventLoop* const& loop);
+    void RunTimers(EventLoop* const& loop);
+    void RunTasks(EventLoop* const& loop);
+    void Poll(EventLoop* const& loop);
+    void Checkpoint(EventLoop* const& loop);
+    void Add(EventLoop* const& loop, EventLoopData *data, uint64_t timeout);
+    void AddImmediate(EventLoop* const& loop, EventLoopData *data);
+    void Remove(EventLoop* const& loop, uint64_t id);
+    void RemoveImmediate(EventLoop* const& loop, uint64_t id);
     bool HasEvents(EventLoop* const& loop);
+    uint64_t NextDeadline(EventLoop* const& loop);
+
+    // the platform's foreground tasks are pumped while the loop is idle
+    void SetPlatform(v8::Platform *platform);
+    // idle GC before blocking `timeout` ms in epoll_wait, -1 for no timeout
+    void Idle(EventLoop* const& loop, int timeout);
+
+    bool Watch(EventLoop* const& loop, int fd, uint32_t events, WatchCallback callback, void *data, bool ref = true);
+    void Unwatch(EventLoop* const& loop, int fd);
+    // whether the watcher on `fd` keeps the loop alive
+    void SetRef(EventLoop* const& loop, int fd, bool ref);
+
+    void QueueWork(EventLoop* const& loop, std::function<void()> work, std::function<void(v8::Local<v8::Context>)> after);
+    // `settle` resolves or rejects the returned promise once `work` is done
+    v8::Local<v8::Promise> QueueWorkPromise(
+        EventLoop* const& loop,
+        v8::Local<v8::Context> ctx,
+        std::function<void()> work,
+        std::function<void(v8::Local<v8::Context>, v8::Local<v8::Promise::Resolver>)> settle
+    );
+    void RunCompletions(int fd, uint32_t events, void *data);
+
+    // the loop's ring with room reserved for one request, nullptr means
+    // the caller has to fall back to the thread pool; pair with FinishUring
+    Uring *ReserveUring(EventLoop* const& loop);
+    void FinishUring(EventLoop* const& loop);
+    void ReapUring(int fd, uint32_t events, void *data);
 
     void setTimeout(const v8::FunctionCallbackInfo<v8::Value>& args);
     void setInterval(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -62,10 +186,13 @@ namespace events {
     void clearImmediate(const v8::FunctionCallbackInfo<v8::Value>& args);
     void clearTimeout(const v8::FunctionCallbackInfo<v8::Value>& args);
     void clearInterval(const v8::FunctionCallbackInfo<v8::Value>& args);
+    void queueMicrotask(const v8::FunctionCallbackInfo<v8::Value>& args);
+    void postTask(const v8::FunctionCallbackInfo<v8::Value>& args);
+    void yield(const v8::FunctionCallbackInfo<v8::Value>& args);
 
     uint64_t getTimeInMs();
 
-    void executionFunc(void *args);
+    void executionFunc(EventLoop* const& loop, v8::Local<v8::Context> ctx, EventLoopData *funcArgs);
 }
 
 #endif
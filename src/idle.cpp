@@ -0,0 +1,157 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "eventLoop.hpp"
+#include "v8-isolate.h"
+#include "v8-platform.h"
+#include <libplatform/libplatform.h>
+#include <v8.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+// V8 gets the loop's idle windows for GC work, so major collections land
+// between callbacks instead of in the middle of them.
+namespace events {
+    // windows shorter than this aren't worth waking the GC for
+    constexpr uint64_t IDLE_MIN_MS = 2;
+    // cap when nothing is scheduled, the GC gives up the rest anyway
+    constexpr uint64_t IDLE_MAX_MS = 50;
+    constexpr uint64_t RSS_CHECK_INTERVAL_MS = 100;
+
+    typedef struct {
+        uint64_t moderate;
+        uint64_t critical;
+    } PressureThresholds;
+
+    static v8::Platform *platform = nullptr;
+
+    void SetPlatform(v8::Platform *current) {
+        platform = current;
+    }
+
+    // SENKORA_MEMORY_PRESSURE_MODERATE_MB / _CRITICAL_MB, unset means never
+    static const PressureThresholds& getThresholds() {
+        static const PressureThresholds thresholds = [] {
+            PressureThresholds result = {0, 0};
+            if (const char *moderate = getenv("SENKORA_MEMORY_PRESSURE_MODERATE_MB")) {
+                result.moderate = strtoull(moderate, nullptr, 10) * 1024 * 1024;
+            }
+            if (const char *critical = getenv("SENKORA_MEMORY_PRESSURE_CRITICAL_MB")) {
+                result.critical = strtoull(critical, nullptr, 10) * 1024 * 1024;
+            }
+            return result;
+        }();
+
+        return thresholds;
+    }
+
+    // resident set size in bytes, 0 if it can't be read
+    static uint64_t getRss() {
+        FILE *statm = fopen("/proc/self/statm", "r");
+        if (statm == nullptr) {
+            return 0;
+        }
+
+        unsigned long long size = 0, resident = 0;
+        int read = fscanf(statm, "%llu %llu", &size, &resident);
+        fclose(statm);
+
+        if (read != 2) {
+            return 0;
+        }
+
+        return (uint64_t) resident * (uint64_t) sysconf(_SC_PAGESIZE);
+    }
+
+    // only tells V8 when the level changes
+    static void updateMemoryPressure(EventLoop* const& loop, uint64_t now) {
+        const PressureThresholds& thresholds = getThresholds();
+        if (thresholds.moderate == 0 && thresholds.critical == 0) {
+            return;
+        }
+
+        if (now - loop->lastRssCheck < RSS_CHECK_INTERVAL_MS) {
+            return;
+        }
+        loop->lastRssCheck = now;
+
+        uint64_t rss = getRss();
+        v8::MemoryPressureLevel level = v8::MemoryPressureLevel::kNone;
+        if (thresholds.critical > 0 && rss >= thresholds.critical) {
+            level = v8::MemoryPressureLevel::kCritical;
+        } else if (thresholds.moderate > 0 && rss >= thresholds.moderate) {
+            level = v8::MemoryPressureLevel::kModerate;
+        }
+
+        if (level != loop->pressure) {
+            loop->pressure = level;
+            loop->isolate->MemoryPressureNotification(level);
+        }
+    }
+
+    void Idle(EventLoop* const& loop, int timeout) {
+        if (loop->isolate == nullptr || timeout == 0) {
+            return;
+        }
+
+        uint64_t start = getTimeInNs();
+
+        // foreground tasks V8 posted (memory reducer, finalizing incremental marking)
+        if (platform != nullptr) {
+            while (v8::platform::PumpMessageLoop(platform, loop->isolate, v8::platform::MessageLoopBehavior::kDoNotWait)) {}
+        }
+
+        uint64_t now = getTimeInMs();
+        updateMemoryPressure(loop, now);
+
+        // the GC said it had nothing left, wait until JS ran again
+        if (loop->idleDone) {
+            return;
+        }
+
+        uint64_t window = IDLE_MAX_MS;
+        if (!loop->timers->Empty()) {
+            uint64_t deadline = NextDeadline(loop);
+            window = deadline > now ? std::min(deadline - now, IDLE_MAX_MS) : 0;
+        }
+        if (timeout > 0) {
+            window = std::min(window, (uint64_t) timeout);
+        }
+
+        if (window < IDLE_MIN_MS) {
+            return;
+        }
+
+        // something is already waiting, handle it first
+        struct epoll_event ready;
+        if (epoll_wait(loop->pollFd, &ready, 1, 0) > 0) {
+            return;
+        }
+
+        double startSeconds = platform != nullptr ? platform->MonotonicallyIncreasingTime() : (double) start / 1e9;
+        loop->idleDone = loop->isolate->IdleNotificationDeadline(startSeconds + (double) window / 1000.0);
+
+        uint64_t spent = getTimeInNs() - start;
+        loop->stats.idleGcTime += spent;
+        // not on any callback's path, keep it out of the tick duration
+        loop->stats.tickIdle += spent;
+    }
+}
@@ -0,0 +1,154 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "loopStats.hpp"
+#include "eventLoop.hpp"
+#include "Senkora.hpp"
+#include "v8-context.h"
+#include "v8-isolate.h"
+#include "v8-local-handle.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+
+#include <cstring>
+#include <time.h>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace events {
+    Histogram::Histogram() {
+        this->Reset();
+    }
+
+    void Histogram::Record(uint64_t value) {
+        this->counts[IndexOf(value)]++;
+        this->count++;
+        this->sum += value;
+        if (value < this->min) {
+            this->min = value;
+        }
+        if (value > this->max) {
+            this->max = value;
+        }
+    }
+
+    void Histogram::Reset() {
+        memset(this->counts, 0, sizeof(this->counts));
+        this->count = 0;
+        this->sum = 0;
+        this->min = UINT64_MAX;
+        this->max = 0;
+    }
+
+    uint64_t Histogram::Percentile(double percentile) const {
+        if (this->count == 0) {
+            return 0;
+        }
+
+        uint64_t target = (uint64_t) ((percentile / 100.0) * (double) this->count + 0.5);
+        if (target == 0) {
+            target = 1;
+        }
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += this->counts[i];
+            if (seen >= target) {
+                uint64_t highest = HighestOf(i);
+                return highest < this->max ? highest : this->max;
+            }
+        }
+
+        return this->max;
+    }
+
+    size_t Histogram::IndexOf(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return (size_t) value;
+        }
+
+        int exponent = 63 - __builtin_clzll(value);
+        size_t sub = (size_t) (value >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+
+        return (size_t) (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    uint64_t Histogram::HighestOf(size_t index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+
+        int exponent = (int) (index / SUB_BUCKETS) + SUB_BITS - 1;
+        uint64_t sub = index % SUB_BUCKETS;
+        uint64_t lowest = ((uint64_t) 1 << exponent) | (sub << (exponent - SUB_BITS));
+
+        return lowest + ((uint64_t) 1 << (exponent - SUB_BITS)) - 1;
+    }
+
+    uint64_t getTimeInNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t) ts.tv_sec * 1000000000) + (uint64_t) ts.tv_nsec;
+    }
+
+    static v8::Local<v8::Object> histogramToObject(v8::Local<v8::Context> ctx, const Histogram& histogram) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        v8::Local<v8::Object> obj = v8::Object::New(isolate);
+
+        const char *names[] = {"min", "max", "mean", "p50", "p90", "p99", "p999"};
+        double values[] = {
+            (double) histogram.Min(),
+            (double) histogram.Max(),
+            histogram.Mean(),
+            (double) histogram.Percentile(50),
+            (double) histogram.Percentile(90),
+            (double) histogram.Percentile(99),
+            (double) histogram.Percentile(99.9)
+        };
+
+        for (int i = 0; i < 7; i++) {
+            obj->Set(ctx, v8::String::NewFromUtf8(isolate, names[i]).ToLocalChecked(), v8::Number::New(isolate, values[i])).Check();
+        }
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "count").ToLocalChecked(), v8::Number::New(isolate, (double) histogram.Count())).Check();
+
+        return obj;
+    }
+
+    void loopStats(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::HandleScope scope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+
+        const EventLoop *loop = globals.globalLoop.get();
+        const LoopStats& stats = loop->stats;
+
+        v8::Local<v8::Object> obj = v8::Object::New(isolate);
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "ticks").ToLocalChecked(), v8::Number::New(isolate, (double) stats.ticks)).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "tickDuration").ToLocalChecked(), histogramToObject(ctx, stats.tickDuration)).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "lag").ToLocalChecked(), histogramToObject(ctx, stats.lag)).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "idleTime").ToLocalChecked(), v8::Number::New(isolate, (double) stats.idleTime / 1000000.0)).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "idleGcTime").ToLocalChecked(), v8::Number::New(isolate, (double) stats.idleGcTime / 1000000.0)).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "pendingImmediates").ToLocalChecked(), v8::Number::New(isolate, (double) loop->pendingImmediates)).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "pendingTasks").ToLocalChecked(), v8::Number::New(isolate, (double) loop->tasks.Size())).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "pendingTimers").ToLocalChecked(), v8::Number::New(isolate, (double) loop->timers->Size())).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "activeHandles").ToLocalChecked(), v8::Number::New(isolate, (double) loop->refs)).Check();
+        obj->Set(ctx, v8::String::NewFromUtf8(isolate, "pendingWork").ToLocalChecked(), v8::Number::New(isolate, (double) loop->pendingWork)).Check();
+
+        args.GetReturnValue().Set(obj);
+    }
+}
@@ -0,0 +1,78 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef LOOPSTATS
+#define LOOPSTATS
+
+#include <cstddef>
+#include <cstdint>
+#include <v8.h>
+
+namespace events {
+
+    // HDR style histogram: values below 16 get a bucket each, larger ones
+    // 16 sub-buckets per power of two, so any recorded value is reported
+    // within ~6% of its real size. Recording is a couple of bit operations.
+    class Histogram {
+        public:
+            Histogram();
+
+            void Record(uint64_t value);
+            void Reset();
+            // smallest bucket value that covers `percentile` (0-100) of the samples
+            uint64_t Percentile(double percentile) const;
+
+            uint64_t Count() const { return this->count; }
+            uint64_t Min() const { return this->count ? this->min : 0; }
+            uint64_t Max() const { return this->max; }
+            double Mean() const { return this->count ? (double) this->sum / (double) this->count : 0; }
+
+        private:
+            static constexpr int SUB_BITS = 4;
+            static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+            static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+            static size_t IndexOf(uint64_t value);
+            static uint64_t HighestOf(size_t index);
+
+            uint64_t counts[BUCKETS];
+            uint64_t count;
+            uint64_t sum;
+            uint64_t min;
+            uint64_t max;
+    };
+
+    typedef struct {
+        uint64_t ticks = 0;
+        // time spent running callbacks and microtasks per tick, in microseconds
+        Histogram tickDuration;
+        // how late timers fired compared to their deadline, in milliseconds
+        Histogram lag;
+        // total time spent blocked waiting for timers or fds, in nanoseconds
+        uint64_t idleTime = 0;
+        // the part of the current tick spent in epoll_wait or idle GC
+        uint64_t tickIdle = 0;
+        // time given to V8 for GC while the loop was idle, in nanoseconds
+        uint64_t idleGcTime = 0;
+    } LoopStats;
+
+    uint64_t getTimeInNs();
+
+    void loopStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+}
+
+#endif
@@ -18,13 +18,16 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <Senkora.hpp>
 #include <ObjectBuilder.hpp>
-#include "event.hpp"
+#include <CodeCache.hpp>
 #include "globalThis.hpp"
 #include "peekaboo.hpp"
 
 #include "cli.hpp"
 #include "eventLoop.hpp"
 #include "project.hpp"
+#include "runtime.hpp"
+#include "snapshot.hpp"
+#include "worker.hpp"
 #include "modules/modules.hpp"
 #include "v8-container.h"
 #include "v8-context.h"
@@ -104,12 +107,19 @@ void Println(const v8::FunctionCallbackInfo<v8::Value>& args) {
     fflush(stdout);
 }
 
+// exceptions nothing else catches, e.g. thrown from a queueMicrotask callback
+void uncaughtException([[maybe_unused]] v8::Local<v8::Message> message, v8::Local<v8::Value> error) {
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+    Senkora::printException(isolate->GetCurrentContext(), error);
+}
+
 // console.*
 void notImplementedFunc(const v8::FunctionCallbackInfo<v8::Value>& args) {
     Senkora::throwException(args.GetIsolate()->GetCurrentContext(), "Not implemented yet", Senkora::ExceptionType::REFERENCE);
 }
 
-inline const Senkora::SharedGlobals globals;
+// one set per isolate, workers get their own on their thread
+inline thread_local const Senkora::SharedGlobals globals;
 const std::unique_ptr<Senkora::TOML::TomlNode> projectConfig = project::parseProjectConfig("project.toml");
 
 void createProject(const fs::path& projectName, [[maybe_unused]] std::any data) {
@@ -180,18 +190,26 @@ void handleProjectConfig(std::string& nextArg, Senkora::TOML::TomlNode* const& p
     }
 }
 
-void run(std::string nextArg, std::any data) {
-    if (nextArg.length() == 0) {
-        printf("Error: missing file\n");
-        return;
+v8::Isolate *runtime::NewIsolate() {
+    static std::shared_ptr<v8::ArrayBuffer::Allocator> allocator(v8::ArrayBuffer::Allocator::NewDefaultAllocator());
+
+    v8::Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator_shared = allocator;
+
+    // with a startup snapshot the contexts come out ready to use
+    if (v8::StartupData *blob = snapshot::Load()) {
+        create_params.snapshot_blob = blob;
+        create_params.external_references = snapshot::ExternalReferences();
     }
 
-    v8::Isolate *isolate = std::any_cast<v8::Isolate*>(data);
-    v8::Isolate::Scope isolate_scope(isolate);
-    v8::HandleScope handle_scope(isolate);
+    v8::Isolate* isolate = v8::Isolate::New(create_params);
+    // microtasks only run at the checkpoints of the event loop
+    isolate->SetMicrotasksPolicy(v8::MicrotasksPolicy::kExplicit);
 
-    isolate->SetCaptureStackTraceForUncaughtExceptions(true);
+    return isolate;
+}
 
+v8::Local<v8::Context> runtime::BuildContext(v8::Isolate *isolate, bool worker) {
     v8::Local<v8::ObjectTemplate> global = globalObject::Init(isolate);
     globalObject::AddFunction(isolate, global, "print", v8::FunctionTemplate::New(isolate, Print));
     globalObject::AddFunction(isolate, global, "println", v8::FunctionTemplate::New(isolate, Println));
@@ -201,17 +219,26 @@ void run(std::string nextArg, std::any data) {
     globalObject::AddFunction(isolate, global, "clearTimeout", v8::FunctionTemplate::New(isolate, events::clearTimeout));
     globalObject::AddFunction(isolate, global, "clearImmediate", v8::FunctionTemplate::New(isolate, events::clearImmediate));
     globalObject::AddFunction(isolate, global, "clearInterval", v8::FunctionTemplate::New(isolate, events::clearInterval));
+    globalObject::AddFunction(isolate, global, "queueMicrotask", v8::FunctionTemplate::New(isolate, events::queueMicrotask));
+
+    v8::Local<v8::ObjectTemplate> scheduler = v8::ObjectTemplate::New(isolate);
+    scheduler->Set(isolate, "postTask", v8::FunctionTemplate::New(isolate, events::postTask));
+    scheduler->Set(isolate, "yield", v8::FunctionTemplate::New(isolate, events::yield));
+    global->Set(isolate, "scheduler", scheduler);
+
+    workers::Init(isolate, global);
+    if (worker) {
+        workers::InitScope(isolate, global);
+    }
     
     v8::Local<v8::ObjectTemplate> senkoraObj = v8::ObjectTemplate::New(isolate);
     senkoraObj->Set(isolate, "version", v8::String::NewFromUtf8(isolate, "0.0.1").ToLocalChecked());
     senkoraObj->Set(isolate, "peekaboo", v8::FunctionTemplate::New(isolate, peekaboo));
+    senkoraObj->Set(isolate, "loopStats", v8::FunctionTemplate::New(isolate, events::loopStats));
+    senkoraObj->Set(isolate, "isWorker", v8::Boolean::New(isolate, worker));
     global->Set(isolate, "Senkora", senkoraObj);
 
-    isolate->SetHostInitializeImportMetaObjectCallback(Senkora::Modules::metadataHook);
-
     v8::Local<v8::Context> ctx = v8::Context::New(isolate, nullptr, global);
-    ctx->AllowCodeGenerationFromStrings(false);
-    ctx->SetErrorMessageForCodeGenerationFromStrings(v8::String::NewFromUtf8(isolate, "both 'eval' and 'Function' constructor are disabled!").ToLocalChecked());
     v8::Context::Scope context_scope(ctx);
 
     auto glob = ObjectBuilder(isolate);
@@ -223,18 +250,55 @@ void run(std::string nextArg, std::any data) {
     }
     glob.Set("console", console.Assemble(ctx));
 
-    Senkora::Modules::initBuiltinModules(isolate);
+    return ctx;
+}
 
-    std::string currentPath = fs::current_path();
-    std::string filePath = nextArg;
-    if (nextArg[0] != '/') {
-        filePath = fs::path(currentPath + "/" + nextArg).lexically_normal();
+void runtime::ExternalReferences(std::vector<intptr_t>& refs) {
+    refs.insert(refs.end(), {
+        reinterpret_cast<intptr_t>(Print),
+        reinterpret_cast<intptr_t>(Println),
+        reinterpret_cast<intptr_t>(notImplementedFunc),
+        reinterpret_cast<intptr_t>(events::setTimeout),
+        reinterpret_cast<intptr_t>(events::setImmediate),
+        reinterpret_cast<intptr_t>(events::setInterval),
+        reinterpret_cast<intptr_t>(events::clearTimeout),
+        reinterpret_cast<intptr_t>(events::clearImmediate),
+        reinterpret_cast<intptr_t>(events::clearInterval),
+        reinterpret_cast<intptr_t>(events::queueMicrotask),
+        reinterpret_cast<intptr_t>(events::postTask),
+        reinterpret_cast<intptr_t>(events::yield),
+        reinterpret_cast<intptr_t>(events::loopStats),
+        reinterpret_cast<intptr_t>(peekaboo),
+    });
+    workers::ExternalReferences(refs);
+}
+
+v8::Local<v8::Context> runtime::CreateContext(v8::Isolate *isolate, bool worker) {
+    isolate->SetCaptureStackTraceForUncaughtExceptions(true);
+    isolate->AddMessageListener(uncaughtException);
+    isolate->SetHostInitializeImportMetaObjectCallback(Senkora::Modules::metadataHook);
+    globals.globalLoop->isolate = isolate;
+
+    // NewIsolate only boots from a blob when Load found one
+    v8::Local<v8::Context> ctx;
+    size_t index = worker ? snapshot::WORKER_CONTEXT : snapshot::MAIN_CONTEXT;
+    if (snapshot::Load() == nullptr || !v8::Context::FromSnapshot(isolate, index).ToLocal(&ctx)) {
+        ctx = runtime::BuildContext(isolate, worker);
     }
-    
+
+    ctx->AllowCodeGenerationFromStrings(false);
+    ctx->SetErrorMessageForCodeGenerationFromStrings(v8::String::NewFromUtf8(isolate, "both 'eval' and 'Function' constructor are disabled!").ToLocalChecked());
+
+    return ctx;
+}
+
+bool runtime::RunModule(v8::Local<v8::Context> ctx, const std::string& filePath) {
+    v8::Isolate *isolate = ctx->GetIsolate();
+
     std::string code = Senkora::readFile(filePath);
     if (!code.length()) {
         Senkora::throwAndPrintException(ctx, "Error: file not found", Senkora::ExceptionType::REFERENCE);
-        exit(1);
+        return false;
     }
     auto meta = std::make_unique<Senkora::MetadataObject>();
     v8::Local<v8::Value> url = v8::String::NewFromUtf8(isolate, filePath.c_str()).ToLocalChecked();
@@ -243,35 +307,65 @@ void run(std::string nextArg, std::any data) {
 
     v8::MaybeLocal<v8::Module> maybeMod = Senkora::compileScript(ctx, code);
     if (maybeMod.IsEmpty()) {
-        exit(1);
+        return false;
     }
     v8::Local<v8::Module> mod = maybeMod.ToLocalChecked();
 
     globals.moduleCache[filePath.c_str()] = mod;
     globals.moduleMetadatas[mod->ScriptId()] = std::move(meta);
 
-    {
-        v8::Isolate::Scope isolate_scope(isolate);
-        v8::Context::Scope ctx_scope(ctx);
-        v8::HandleScope handle_scope(isolate);
-
-        v8::TryCatch tryCatch(isolate);
-        if (v8::Maybe<bool> out = mod->InstantiateModule(ctx, Senkora::Modules::moduleResolver); out.IsNothing()) {
-            if (v8::Module::kUninstantiated == mod->GetStatus()) {
-                Senkora::printException(ctx, tryCatch.Exception());
-                exit(1);
-            }
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::Context::Scope ctx_scope(ctx);
+    v8::HandleScope handle_scope(isolate);
+
+    v8::TryCatch tryCatch(isolate);
+    if (v8::Maybe<bool> out = mod->InstantiateModule(ctx, Senkora::Modules::moduleResolver); out.IsNothing()) {
+        if (v8::Module::kUninstantiated == mod->GetStatus()) {
+            Senkora::printException(ctx, tryCatch.Exception());
+            Senkora::CodeCache::Flush(isolate);
+            return false;
         }
+    }
 
-        if (v8::MaybeLocal<v8::Value> res = mod->Evaluate(ctx); mod->GetStatus() == v8::Module::kErrored && !res.IsEmpty()) {
-            if (v8::Module::kErrored == mod->GetStatus()) {
-                Senkora::printException(ctx, mod->GetException());
-                exit(1);
-            }
+    if (v8::MaybeLocal<v8::Value> res = mod->Evaluate(ctx); mod->GetStatus() == v8::Module::kErrored && !res.IsEmpty()) {
+        if (v8::Module::kErrored == mod->GetStatus()) {
+            Senkora::printException(ctx, mod->GetException());
+            Senkora::CodeCache::Flush(isolate);
+            return false;
         }
+    }
+
+    // every module of the graph has been compiled and run by now
+    Senkora::CodeCache::Flush(isolate);
+
+    // a worker terminated during its top level code
+    return !tryCatch.HasTerminated();
+}
+
+void run(std::string nextArg, std::any data) {
+    if (nextArg.length() == 0) {
+        printf("Error: missing file\n");
+        return;
+    }
+
+    v8::Isolate *isolate = std::any_cast<v8::Isolate*>(data);
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope handle_scope(isolate);
 
-        events::Run(globals.globalLoop.get());
+    v8::Local<v8::Context> ctx = runtime::CreateContext(isolate);
+    v8::Context::Scope context_scope(ctx);
+
+    std::string currentPath = fs::current_path();
+    std::string filePath = nextArg;
+    if (nextArg[0] != '/') {
+        filePath = fs::path(currentPath + "/" + nextArg).lexically_normal();
     }
+
+    if (!runtime::RunModule(ctx, filePath)) {
+        exit(1);
+    }
+
+    events::Run(globals.globalLoop.get());
 }
 
 void runDot(std::string nextArg, std::any args) {
@@ -286,6 +380,19 @@ void runDot(std::string nextArg, std::any args) {
     run(nextArg, args);
 }
 
+void createSnapshot(std::string nextArg, [[maybe_unused]] std::any data) {
+    std::string path = nextArg.length() ? nextArg : snapshot::Path();
+    if (path.empty()) {
+        printf("Error: missing snapshot file\n");
+        exit(1);
+    }
+
+    if (!snapshot::Create(path)) {
+        printf("Error: failed to write the snapshot to %s\n", path.c_str());
+        exit(1);
+    }
+}
+
 void printVersion([[maybe_unused]] std::string nextArg, [[maybe_unused]] std::any args) {
     printf(R"(Senkora Copyright (C) 2023  SenkoraJS
 This program comes with ABSOLUTELY NO WARRANTY; for details type `show w'.
@@ -305,6 +412,7 @@ OPTIONS:
   version, -v         Display version
   run <SCRIPT>        Execute <SCRIPT> file
   create <NAME>       Create a new project with the name <NAME>
+  snapshot [FILE]     Write the startup snapshot to [FILE]
 )");
 }
 
@@ -318,6 +426,7 @@ OPTIONS:
   version, -v         Display version
   run <SCRIPT>        Execute <SCRIPT> file
   create <NAME>       Create a new project with the name <NAME>
+  snapshot [FILE]     Write the startup snapshot to [FILE]
 )");
 }
 
@@ -328,12 +437,9 @@ int main(int argc, char* argv[]) {
     v8::V8::SetFlagsFromString("--use-strict true ");
     v8::V8::InitializePlatform(platform.get());
     v8::V8::Initialize();
+    events::SetPlatform(platform.get());
 
-    v8::Isolate::CreateParams create_params;
-    create_params.array_buffer_allocator =
-        v8::ArrayBuffer::Allocator::NewDefaultAllocator();
-
-    v8::Isolate* isolate = v8::Isolate::New(create_params);
+    v8::Isolate* isolate = runtime::NewIsolate();
 
     std::vector<std::any> args{isolate, false};
 
@@ -345,6 +451,7 @@ int main(int argc, char* argv[]) {
     argHandler.onArg(".", runDot, isolate);
     argHandler.onArg("run", run, isolate);
     argHandler.onArg("create", createProject, nullptr);
+    argHandler.onArg("snapshot", createSnapshot, nullptr);
     argHandler.run();
 
     isolate->Dispose();
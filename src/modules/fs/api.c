@@ -15,7 +15,7 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
-#define _GNU_SOURCE // Required for DT_DIR
+#define _GNU_SOURCE // Required for IOV_MAX, madvise and copy_file_range
 #include "api.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -23,102 +23,183 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
 
-int writeToFile(const char *filename, const char *data)
+// Writes every chunk in order with as few writev calls as IOV_MAX allows,
+// picking up again after partial writes. `chunks` is left as it was.
+// With an `offset` of -1 they go at the file position, else pwritev puts
+// them at `offset` and the position stays where it was.
+int writeChunksToFd(int fd, const struct iovec *chunks, int count, off_t offset)
 {
-    FILE *f = fopen(filename, "wb");
-    size_t size = strlen(data);
+    int next = 0;
+    size_t skip = 0; // into chunks[next], after a partial write
 
-    if (f == NULL)
+    while (next < count)
     {
-        return 0;
-    }
+        if (skip == chunks[next].iov_len)
+        {
+            next++;
+            skip = 0;
+            continue;
+        }
 
-    for (int i = 0; i < size; i++)
-    {
-        fputc(data[i], f);
-    }
+        struct iovec batch[IOV_MAX];
+        int used = 0;
+        for (int i = next; i < count && used < IOV_MAX; i++, used++)
+        {
+            size_t from = i == next ? skip : 0;
+            batch[used].iov_base = (char *)chunks[i].iov_base + from;
+            batch[used].iov_len = chunks[i].iov_len - from;
+        }
 
-    fclose(f);
+        ssize_t written = offset == -1 ? writev(fd, batch, used) : pwritev(fd, batch, used, offset);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            return 0;
+        }
+
+        if (offset != -1)
+        {
+            offset += written;
+        }
+
+        // step over what the kernel took, possibly stopping mid-chunk
+        while (written > 0)
+        {
+            size_t left = chunks[next].iov_len - skip;
+            if ((size_t)written >= left)
+            {
+                written -= left;
+                next++;
+                skip = 0;
+            }
+            else
+            {
+                skip += written;
+                written = 0;
+            }
+        }
+    }
 
     return 1;
 }
 
-char *readFromFile(const char *filename)
+int writeChunksToFile(const char *filename, const struct iovec *chunks, int count, int append)
 {
-    FILE *f = fopen(filename, "rb");
-    char *str = malloc(1);
-    int len = 1;
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    int fd = open(filename, flags, 0666);
 
-    if (f == NULL)
+    if (fd == -1)
     {
-        return NULL;
+        return 0;
     }
 
-    while (!feof(f))
-    {
-        str = realloc(str, len + 1);
-        str[len - 1] = (char)fgetc(f);
-        len++;
-    }
-    str[len - 2] = '\0';
+    int ok = writeChunksToFd(fd, chunks, count, -1);
+    close(fd);
 
-    fclose(f);
-    return str;
+    return ok;
 }
 
-int deleteFile(const char *filename)
+int writeToFile(const char *filename, const char *data, size_t length, int append)
 {
-    if (unlink(filename) == 0)
+    struct iovec chunk = {(void *)data, length};
+    return writeChunksToFile(filename, &chunk, 1, append);
+}
+
+// Reads the whole file into a malloc'd buffer sized from fstat. The buffer
+// is NUL terminated for convenience, but `length` is what counts: the file
+// may contain NULs itself. The caller frees it.
+char *readFromFile(const char *filename, size_t *length)
+{
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
     {
-        return 1;
+        return NULL;
     }
-    else
+
+    struct stat s;
+    if (fstat(fd, &s) == -1)
     {
-        return 0;
+        close(fd);
+        return NULL;
     }
-}
-
-int deleteDirectory(const char *dirname)
-{
-    DIR *dir;
-    struct dirent *entry;
-    char path[PATH_MAX];
 
-    dir = opendir(dirname);
+    // procfs, pipes and the like report 0, those grow as they are read
+    size_t expected = S_ISREG(s.st_mode) ? (size_t)s.st_size : 0;
+    size_t capacity = expected > 0 ? expected + 1 : 65536;
+    size_t len = 0;
+    char *str = malloc(capacity);
 
-    if (dir == NULL)
+    if (str == NULL)
     {
-        return 0; // Failed to open directory
+        close(fd);
+        return NULL;
     }
 
-    while ((entry = readdir(dir)) != NULL)
+    while (expected == 0 || len < expected)
     {
-        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+        if (len + 1 == capacity)
         {
-            snprintf(path, sizeof(path), "%s/%s", dirname, entry->d_name);
-
-            if (entry->d_type == DT_DIR)
+            char *grown = realloc(str, capacity * 2);
+            if (grown == NULL)
             {
-                deleteDirectory(path); // Recursively delete subdirectories
+                free(str);
+                close(fd);
+                return NULL;
             }
-            else
+            str = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, str + len, capacity - len - 1);
+        if (n == -1)
+        {
+            if (errno == EINTR)
             {
-                deleteFile(path); // Delete individual files
+                continue;
             }
+
+            free(str);
+            close(fd);
+            return NULL;
+        }
+
+        if (n == 0)
+        {
+            break; // EOF, or the file shrank since fstat
         }
+
+        len += n;
     }
 
-    closedir(dir);
+    close(fd);
 
-    if (rmdir(dirname) == 0)
+    str[len] = '\0';
+    *length = len;
+    return str;
+}
+
+int deleteFile(const char *filename)
+{
+    if (unlink(filename) == 0)
     {
-        return 1; // Successfully deleted the directory
+        return 1;
     }
     else
     {
-        return 0; // Failed to delete the directory
+        return 0;
     }
 }
 
@@ -182,3 +263,232 @@ int createDirectory(const char *dirname)
         return 0;
     }
 }
+
+// Maps the whole file copy-on-write, writes through the mapping never reach
+// the file. Empty files succeed with *data set to NULL. Files mmap can't
+// handle (procfs, pipes) fail with *data set to MAP_FAILED so the caller
+// can fall back to readFromFile.
+int mapFile(const char *filename, void **data, size_t *length)
+{
+    *data = NULL;
+    *length = 0;
+
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return 0;
+    }
+
+    struct stat s;
+    if (fstat(fd, &s) == -1)
+    {
+        close(fd);
+        return 0;
+    }
+
+    if (!S_ISREG(s.st_mode))
+    {
+        close(fd);
+        *data = MAP_FAILED;
+        return 0;
+    }
+
+    if (s.st_size == 0)
+    {
+        close(fd);
+        return 1;
+    }
+
+    void *mapping = mmap(NULL, (size_t)s.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference
+
+    if (mapping == MAP_FAILED)
+    {
+        *data = MAP_FAILED;
+        return 0;
+    }
+
+    madvise(mapping, (size_t)s.st_size, MADV_SEQUENTIAL);
+
+    *data = mapping;
+    *length = (size_t)s.st_size;
+    return 1;
+}
+
+void unmapFile(void *data, size_t length)
+{
+    munmap(data, length);
+}
+
+// Moves `size` bytes from `in` to `out` with the cheapest thing the kernel
+// offers, each step picking up at the file offsets where the last one gave
+// up: a reflink shares the extents outright, copy_file_range copies in the
+// kernel (server side on NFS and SMB), sendfile at least skips user space.
+// The read/write loop only sees what they couldn't do, or files that
+// report no size, like procfs, and runs until EOF in case the file grew.
+static int copyData(int in, int out, off_t size)
+{
+#ifdef FICLONE
+    if (size > 0 && ioctl(out, FICLONE, in) == 0)
+    {
+        return 1;
+    }
+#endif
+
+    off_t done = 0;
+
+    while (done < size)
+    {
+        ssize_t n = copy_file_range(in, NULL, out, NULL, (size_t)(size - done), 0);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        // EXDEV, EINVAL, ENOSYS, ... or the file shrank
+        if (n <= 0)
+        {
+            break;
+        }
+        done += n;
+    }
+
+    while (done < size)
+    {
+        ssize_t n = sendfile(out, in, NULL, (size_t)(size - done));
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        done += n;
+    }
+
+    char buffer[64 * 1024];
+    for (;;)
+    {
+        ssize_t n = read(in, buffer, sizeof(buffer));
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n == -1)
+        {
+            return 0;
+        }
+        if (n == 0)
+        {
+            return 1;
+        }
+
+        for (ssize_t written = 0; written < n;)
+        {
+            ssize_t w = write(out, buffer + written, (size_t)(n - written));
+            if (w == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (w == -1)
+            {
+                return 0;
+            }
+            written += w;
+        }
+    }
+}
+
+// Creates a file no one else uses in the directory of `path`, to be
+// renamed over it later. Its name is left in `tmp`.
+static int openTemporary(const char *path, mode_t mode, char *tmp, size_t size)
+{
+    static unsigned counter;
+
+    const char *slash = strrchr(path, '/');
+    int dirLength = slash == NULL ? 0 : (int)(slash - path + 1);
+
+    for (int tries = 0; tries < 16; tries++)
+    {
+        unsigned n = __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+        int length = snprintf(tmp, size, "%.*s.senkora-%d-%u", dirLength, path, (int)getpid(), n);
+        if (length < 0 || (size_t)length >= size)
+        {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+
+        int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+        if (fd != -1 || errno != EEXIST)
+        {
+            return fd;
+        }
+    }
+
+    return -1;
+}
+
+// Copies the content and permission bits of `src` to `dst`, replacing dst
+// unless `overwrite` is 0. A replaced dst only goes once the copy is
+// complete, renamed over by it, and a failed copy leaves dst as it was.
+int copyFile(const char *src, const char *dst, int overwrite)
+{
+    int in = open(src, O_RDONLY | O_CLOEXEC);
+    if (in == -1)
+    {
+        return 0;
+    }
+
+    struct stat s;
+    if (fstat(in, &s) == -1 || S_ISDIR(s.st_mode))
+    {
+        close(in);
+        return 0;
+    }
+
+    char tmp[PATH_MAX];
+    int out;
+    if (overwrite)
+    {
+        // a copy of a file over itself would be no copy at all
+        struct stat d;
+        if (stat(dst, &d) == 0 && d.st_dev == s.st_dev && d.st_ino == s.st_ino)
+        {
+            close(in);
+            return 0;
+        }
+        out = openTemporary(dst, s.st_mode & 0777, tmp, sizeof(tmp));
+    }
+    else
+    {
+        out = open(dst, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, s.st_mode & 0777);
+    }
+
+    if (out == -1)
+    {
+        close(in);
+        return 0;
+    }
+
+    // either way the file being written is one this call created
+    const char *target = overwrite ? tmp : dst;
+    int ok = copyData(in, out, S_ISREG(s.st_mode) ? s.st_size : 0);
+
+    close(in);
+    if (close(out) == -1)
+    {
+        ok = 0;
+    }
+
+    if (ok && overwrite && rename(tmp, dst) == -1)
+    {
+        ok = 0;
+    }
+
+    if (!ok)
+    {
+        unlink(target);
+    }
+
+    return ok;
+}
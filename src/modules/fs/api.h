@@ -19,13 +19,21 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define _FS_API_
 #define PATH_MAX 4096
 
-int writeToFile(const char *filename, const char *data);
-char *readFromFile(const char *filename);
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+int writeToFile(const char *filename, const char *data, size_t length, int append);
+int writeChunksToFile(const char *filename, const struct iovec *chunks, int count, int append);
+int writeChunksToFd(int fd, const struct iovec *chunks, int count, off_t offset);
+char *readFromFile(const char *filename, size_t *length);
 int deleteFile(const char *filename);
-int deleteDirectory(const char *dirname);
 int exists(const char *path);
 int existsFile(const char *filename);
 int existsDirectory(const char *dirname);
 int createDirectory(const char *dirname);
+int mapFile(const char *filename, void **data, size_t *length);
+void unmapFile(void *data, size_t length);
+int copyFile(const char *src, const char *dst, int overwrite);
 
 #endif
@@ -0,0 +1,193 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+extern "C" {
+    #include "api.h"
+}
+#include "batch.hpp"
+#include "direntries.hpp"
+#include "../../threadPool.hpp"
+#include "v8-array-buffer.h"
+#include "v8-context.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-typed-array.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+
+namespace fsMod {
+    // a stat is cheap, hand them out in runs so threads don't fight over the counter
+    constexpr size_t STAT_GRAIN = 256;
+
+    bool getPathsArg(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, std::vector<std::string>& paths) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+
+        if (!value->IsArray()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be an array of strings");
+            return false;
+        }
+
+        v8::Local<v8::Array> array = value.As<v8::Array>();
+        uint32_t length = array->Length();
+        paths.resize(length);
+
+        for (uint32_t i = 0; i < length; i++) {
+            v8::Local<v8::Value> item;
+            if (!array->Get(ctx, i).ToLocal(&item)) {
+                return false;
+            }
+            if (!item->IsString()) {
+                Senkora::throwException(ctx, "Expected argument 1 to be an array of strings");
+                return false;
+            }
+
+            // straight into the std::string, no Utf8Value copy in between
+            v8::Local<v8::String> str = item.As<v8::String>();
+            std::string& path = paths[i];
+            path.resize(str->Utf8Length(isolate));
+            str->WriteUtf8(isolate, path.data(), (int) path.size(), nullptr, v8::String::NO_NULL_TERMINATION);
+        }
+
+        return true;
+    }
+
+    StatBatch newStatBatch(v8::Isolate *isolate, size_t count) {
+        StatBatch batch;
+        batch.count = count;
+        batch.size = v8::ArrayBuffer::NewBackingStore(isolate, count * sizeof(double));
+        batch.mtime = v8::ArrayBuffer::NewBackingStore(isolate, count * sizeof(double));
+        batch.mode = v8::ArrayBuffer::NewBackingStore(isolate, count * sizeof(uint32_t));
+        batch.kind = v8::ArrayBuffer::NewBackingStore(isolate, count * sizeof(uint8_t));
+        return batch;
+    }
+
+    void statPaths(const std::vector<std::string>& paths, StatBatch& batch) {
+        double *size = (double *) batch.size->Data();
+        double *mtime = (double *) batch.mtime->Data();
+        uint32_t *mode = (uint32_t *) batch.mode->Data();
+        uint8_t *kind = (uint8_t *) batch.kind->Data();
+
+        events::ParallelFor(batch.count, STAT_GRAIN, [&](size_t i) {
+            struct stat s;
+            if (stat(paths[i].c_str(), &s) == -1) {
+                size[i] = 0;
+                mtime[i] = 0;
+                mode[i] = 0;
+                kind[i] = UNKNOWN;
+                return;
+            }
+
+            size[i] = (double) s.st_size;
+            mtime[i] = (double) s.st_mtim.tv_sec * 1000 + (double) s.st_mtim.tv_nsec / 1e6;
+            mode[i] = s.st_mode;
+            kind[i] = typeFromMode(s.st_mode);
+        });
+    }
+
+    v8::Local<v8::Object> statBatchToObject(v8::Local<v8::Context> ctx, const StatBatch& batch) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        size_t count = batch.count;
+
+        v8::Local<v8::Object> result = v8::Object::New(isolate);
+        result->Set(ctx, v8::String::NewFromUtf8Literal(isolate, "size"),
+            v8::Float64Array::New(v8::ArrayBuffer::New(isolate, batch.size), 0, count)).Check();
+        result->Set(ctx, v8::String::NewFromUtf8Literal(isolate, "mtime"),
+            v8::Float64Array::New(v8::ArrayBuffer::New(isolate, batch.mtime), 0, count)).Check();
+        result->Set(ctx, v8::String::NewFromUtf8Literal(isolate, "mode"),
+            v8::Uint32Array::New(v8::ArrayBuffer::New(isolate, batch.mode), 0, count)).Check();
+        result->Set(ctx, v8::String::NewFromUtf8Literal(isolate, "kind"),
+            v8::Uint8Array::New(v8::ArrayBuffer::New(isolate, batch.kind), 0, count)).Check();
+        return result;
+    }
+
+    void readPaths(const std::vector<std::string>& paths, std::vector<FileContent>& files) {
+        files.resize(paths.size());
+
+        events::ParallelFor(paths.size(), 1, [&](size_t i) {
+            files[i].data = readFromFile(paths[i].c_str(), &files[i].length);
+        });
+    }
+
+    v8::Local<v8::Array> filesToArray(v8::Local<v8::Context> ctx, std::vector<FileContent>& files) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        v8::Local<v8::Array> result = v8::Array::New(isolate, (int) files.size());
+
+        for (size_t i = 0; i < files.size(); i++) {
+            FileContent& file = files[i];
+            if (file.data == nullptr) {
+                result->Set(ctx, (uint32_t) i, v8::Null(isolate)).Check();
+                continue;
+            }
+
+            std::unique_ptr<v8::BackingStore> store = v8::ArrayBuffer::NewBackingStore(file.data, file.length, [](void *data, [[maybe_unused]] size_t length, [[maybe_unused]] void *deleterData) {
+                free(data);
+            }, nullptr);
+            file.data = nullptr;
+
+            v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(isolate, std::move(store));
+            result->Set(ctx, (uint32_t) i, v8::Uint8Array::New(buffer, 0, file.length)).Check();
+        }
+
+        return result;
+    }
+
+    void statManyJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        std::vector<std::string> paths;
+        if (!getPathsArg(ctx, args[0], paths)) {
+            return;
+        }
+
+        StatBatch batch = newStatBatch(isolate, paths.size());
+        statPaths(paths, batch);
+        args.GetReturnValue().Set(statBatchToObject(ctx, batch));
+    }
+
+    void readManyJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        std::vector<std::string> paths;
+        if (!getPathsArg(ctx, args[0], paths)) {
+            return;
+        }
+
+        std::vector<FileContent> files;
+        readPaths(paths, files);
+        args.GetReturnValue().Set(filesToArray(ctx, files));
+    }
+}
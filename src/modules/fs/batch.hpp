@@ -0,0 +1,64 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FS_BATCH
+#define FS_BATCH
+
+#include "v8-array-buffer.h"
+#include <v8.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// One call for many paths, the syscalls spread over the thread pool
+namespace fsMod {
+    // Struct of arrays with a slot per path. kind is the EntryType of the
+    // path with symlinks followed, 0 where stat failed.
+    typedef struct {
+        size_t count;
+        std::shared_ptr<v8::BackingStore> size;  // Float64Array, bytes
+        std::shared_ptr<v8::BackingStore> mtime; // Float64Array, ms since the epoch
+        std::shared_ptr<v8::BackingStore> mode;  // Uint32Array
+        std::shared_ptr<v8::BackingStore> kind;  // Uint8Array
+    } StatBatch;
+
+    // malloc'ed content of a file, data is nullptr where reading failed
+    typedef struct {
+        char *data;
+        size_t length;
+    } FileContent;
+
+    // false with an exception pending unless `value` is an array of strings
+    bool getPathsArg(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, std::vector<std::string>& paths);
+
+    // allocated on the loop thread, filled in from anywhere
+    StatBatch newStatBatch(v8::Isolate *isolate, size_t count);
+    void statPaths(const std::vector<std::string>& paths, StatBatch& batch);
+    v8::Local<v8::Object> statBatchToObject(v8::Local<v8::Context> ctx, const StatBatch& batch);
+
+    void readPaths(const std::vector<std::string>& paths, std::vector<FileContent>& files);
+    // hands the buffers over to Uint8Arrays, null for the failed ones
+    v8::Local<v8::Array> filesToArray(v8::Local<v8::Context> ctx, std::vector<FileContent>& files);
+
+    // statMany(paths), { size, mtime, mode, kind } typed arrays indexed like paths
+    void statManyJS(const v8::FunctionCallbackInfo<v8::Value>& args);
+    // readMany(paths), a Uint8Array or null per path
+    void readManyJS(const v8::FunctionCallbackInfo<v8::Value>& args);
+}
+
+#endif
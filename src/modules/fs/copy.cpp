@@ -0,0 +1,136 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+extern "C" {
+    #include "api.h"
+}
+#include "copy.hpp"
+#include "direntries.hpp"
+#include "../../threadPool.hpp"
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fsMod {
+    static std::string join(const std::string& dir, const std::string& name) {
+        return dir.empty() ? name : dir + "/" + name;
+    }
+
+    static bool copyLink(int dirFd, const char *name, const std::string& target, bool overwrite) {
+        char link[4096];
+        ssize_t length = readlinkat(dirFd, name, link, sizeof(link) - 1);
+        if (length == -1) {
+            return false;
+        }
+        link[length] = '\0';
+
+        if (symlink(link, target.c_str()) == 0) {
+            return true;
+        }
+        if (errno != EEXIST || !overwrite || unlink(target.c_str()) == -1) {
+            return false;
+        }
+        return symlink(link, target.c_str()) == 0;
+    }
+
+    bool copyTree(const std::string& src, const std::string& dst, bool overwrite) {
+        struct stat s;
+        if (stat(src.c_str(), &s) == -1 || !S_ISDIR(s.st_mode)) {
+            return false;
+        }
+        // directories stay writable for us, or their files couldn't go in
+        if (mkdir(dst.c_str(), (s.st_mode & 07777) | S_IRWXU) == -1 && errno != EEXIST) {
+            return false;
+        }
+
+        // dst may be inside src, it mustn't be copied into itself
+        struct stat target;
+        if (stat(dst.c_str(), &target) == -1 || !S_ISDIR(target.st_mode) || (target.st_dev == s.st_dev && target.st_ino == s.st_ino)) {
+            return false;
+        }
+
+        bool failed = false;
+        std::vector<std::string> files;
+        std::vector<std::string> pending = { "" };
+
+        while (!pending.empty()) {
+            std::string dir = std::move(pending.back());
+            pending.pop_back();
+
+            std::string from = dir.empty() ? src : src + "/" + dir;
+            int dirFd = open(from.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (dirFd == -1) {
+                failed = true;
+                continue;
+            }
+            DirFd owner(dirFd);
+
+            bool ok = scanDirectory(dirFd, [&](const char *name, EntryType type) {
+                std::string relative = join(dir, name);
+                std::string to = dst + "/" + relative;
+
+                switch (type) {
+                    case FILE:
+                        files.push_back(std::move(relative));
+                        break;
+                    case DIRECTORY: {
+                        struct stat d;
+                        if (fstatat(dirFd, name, &d, AT_SYMLINK_NOFOLLOW) == -1) {
+                            failed = true;
+                            break;
+                        }
+                        if (d.st_dev == target.st_dev && d.st_ino == target.st_ino) {
+                            break;
+                        }
+                        if (mkdir(to.c_str(), (d.st_mode & 07777) | S_IRWXU) == -1 && errno != EEXIST) {
+                            failed = true;
+                            break;
+                        }
+                        pending.push_back(std::move(relative));
+                        break;
+                    }
+                    case SYMLINK:
+                        if (!copyLink(dirFd, name, to, overwrite)) {
+                            failed = true;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            });
+
+            if (!ok) {
+                failed = true;
+            }
+        }
+
+        std::atomic<bool> copyFailed{false};
+        events::ParallelFor(files.size(), 1, [&](size_t i) {
+            std::string from = src + "/" + files[i];
+            std::string to = dst + "/" + files[i];
+            if (!copyFile(from.c_str(), to.c_str(), overwrite)) {
+                copyFailed = true;
+            }
+        });
+
+        return !failed && !copyFailed;
+    }
+}
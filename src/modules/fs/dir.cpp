@@ -0,0 +1,350 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "dir.hpp"
+#include "direntries.hpp"
+#include "iterator.hpp"
+#include "v8-array-buffer.h"
+#include "v8-context.h"
+#include "v8-exception.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-promise.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <deque>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace fsMod {
+    constexpr size_t DEFAULT_BATCH_SIZE = 1024;
+
+    static const char *entryTypeNames[ENTRY_TYPES] = {
+        "unknown", "file", "directory", "symlink", "block", "character", "fifo", "socket"
+    };
+
+    typedef struct {
+        std::string name;
+        EntryType type;
+    } Entry;
+
+    static v8::Local<v8::Array> entriesToArray(v8::Local<v8::Context> ctx, const std::vector<Entry>& entries, const char *key) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+
+        v8::Local<v8::String> keyName = v8::String::NewFromUtf8(isolate, key, v8::NewStringType::kInternalized).ToLocalChecked();
+        v8::Local<v8::String> typeName = v8::String::NewFromUtf8Literal(isolate, "type", v8::NewStringType::kInternalized);
+        v8::Local<v8::String> types[ENTRY_TYPES];
+        for (int i = 0; i < ENTRY_TYPES; i++) {
+            types[i] = v8::String::NewFromUtf8(isolate, entryTypeNames[i], v8::NewStringType::kInternalized).ToLocalChecked();
+        }
+
+        v8::Local<v8::Array> array = v8::Array::New(isolate, (int) entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            const Entry& entry = entries[i];
+
+            v8::Local<v8::Object> obj = v8::Object::New(isolate);
+            v8::Local<v8::String> name = v8::String::NewFromUtf8(isolate, entry.name.data(), v8::NewStringType::kNormal, (int) entry.name.size()).ToLocalChecked();
+            obj->Set(ctx, keyName, name).Check();
+            obj->Set(ctx, typeName, types[entry.type]).Check();
+            array->Set(ctx, (uint32_t) i, obj).Check();
+        }
+
+        return array;
+    }
+
+    void readDirJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+        int fd = open(*pathUtf8, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+            Senkora::throwException(ctx, "Failed to open directory");
+            return;
+        }
+
+        std::vector<Entry> entries;
+        bool ok = scanDirectory(fd, [&entries](const char *name, EntryType type) {
+            entries.push_back({ name, type });
+        });
+        close(fd);
+
+        if (!ok) {
+            Senkora::throwException(ctx, "Failed to read directory");
+            return;
+        }
+
+        args.GetReturnValue().Set(entriesToArray(ctx, entries, "name"));
+    }
+
+    typedef struct {
+        std::shared_ptr<DirFd> parent;
+        // relative to parent, the whole path for the root
+        std::string name;
+        std::string path;
+        int depth;
+    } DirJob;
+
+    // Directories are scanned by up to one job per pool thread. A job
+    // keeps taking directories off the shared queue until it has filled a
+    // batch, then hands it to the loop which starts more jobs as needed.
+    // Finished batches pile up to a small limit before scanning pauses.
+    class Walker : public AsyncSource {
+        public:
+            Walker(v8::Isolate *isolate, size_t batchSize, int maxDepth):
+                isolate(isolate), batchSize(batchSize), maxDepth(maxDepth) {
+                this->parallelism = events::GetThreadPool().Size();
+                this->maxReady = this->parallelism * 2;
+            }
+
+            void Start(std::shared_ptr<DirFd> root, const std::string& path) {
+                // the root is opened by the caller, jobs start at its entries
+                this->dirs.push_back({ std::move(root), "", path, 0 });
+                this->Pump();
+            }
+
+            void Next(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) override {
+                this->waiting.emplace_back(this->isolate, resolver);
+                this->Deliver(ctx);
+                this->Pump();
+            }
+
+            void Return(v8::Local<v8::Context> ctx) override {
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->stopped = true;
+                    this->dirs.clear();
+                    this->ready.clear();
+                }
+                this->Deliver(ctx);
+            }
+
+        private:
+            // starts jobs while there are directories to scan, threads to
+            // spare and room for their batches
+            void Pump() {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                while (!this->stopped && this->running < this->parallelism && this->running < this->dirs.size()
+                    && this->ready.size() + this->running < this->maxReady) {
+                    this->running++;
+
+                    auto self = std::static_pointer_cast<Walker>(this->shared_from_this());
+                    events::QueueWork(globals.globalLoop.get(), [self] {
+                        self->Scan();
+                    }, [self](v8::Local<v8::Context> ctx) {
+                        {
+                            std::lock_guard<std::mutex> lock(self->mutex);
+                            self->running--;
+                        }
+                        self->Deliver(ctx);
+                        self->Pump();
+                    });
+                }
+            }
+
+            // on a pool thread
+            void Scan() {
+                std::vector<Entry> batch;
+
+                for (;;) {
+                    DirJob job;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        if (this->stopped || this->dirs.empty()) {
+                            break;
+                        }
+                        // newest first, depth first keeps few parent fds open
+                        job = std::move(this->dirs.back());
+                        this->dirs.pop_back();
+                    }
+
+                    int fd = job.name.empty()
+                        ? dup(job.parent->fd)
+                        : openat(job.parent->fd, job.name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                    job.parent.reset();
+                    if (fd == -1) {
+                        // gone or unreadable, the rest of the tree still counts
+                        continue;
+                    }
+
+                    auto dir = std::make_shared<DirFd>(fd);
+                    std::vector<DirJob> subdirs;
+
+                    scanDirectory(fd, [&](const char *name, EntryType type) {
+                        std::string path = job.path + "/" + name;
+                        if (type == DIRECTORY && (this->maxDepth < 0 || job.depth < this->maxDepth)) {
+                            subdirs.push_back({ dir, name, path, job.depth + 1 });
+                        }
+                        batch.push_back({ std::move(path), type });
+                    });
+
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        for (auto& subdir : subdirs) {
+                            this->dirs.push_back(std::move(subdir));
+                        }
+                    }
+
+                    if (batch.size() >= this->batchSize) {
+                        break;
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(this->mutex);
+                // big directories can overshoot, split them back to size
+                for (size_t start = 0; start < batch.size() && !this->stopped; start += this->batchSize) {
+                    size_t end = std::min(start + this->batchSize, batch.size());
+                    this->ready.emplace_back(std::make_move_iterator(batch.begin() + start), std::make_move_iterator(batch.begin() + end));
+                }
+            }
+
+            // resolves waiting next() calls with ready batches, or with done
+            // once nothing is left anywhere
+            void Deliver(v8::Local<v8::Context> ctx) {
+                while (!this->waiting.empty()) {
+                    std::vector<Entry> batch;
+                    bool finished;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        if (!this->ready.empty()) {
+                            batch = std::move(this->ready.front());
+                            this->ready.pop_front();
+                        }
+                        finished = this->ready.empty() && batch.empty() && (this->stopped || (this->dirs.empty() && this->running == 0));
+                    }
+
+                    if (batch.empty() && !finished) {
+                        return;
+                    }
+
+                    v8::Local<v8::Promise::Resolver> resolver = this->waiting.front().Get(this->isolate);
+                    this->waiting.pop_front();
+
+                    if (finished) {
+                        resolver->Resolve(ctx, iterResult(ctx, v8::Undefined(this->isolate), true)).Check();
+                    } else {
+                        resolver->Resolve(ctx, iterResult(ctx, entriesToArray(ctx, batch, "path"), false)).Check();
+                    }
+                }
+            }
+
+            v8::Isolate *isolate;
+            size_t batchSize;
+            int maxDepth;
+            size_t parallelism;
+            size_t maxReady;
+
+            std::mutex mutex;
+            std::deque<DirJob> dirs;
+            std::deque<std::vector<Entry>> ready;
+            size_t running = 0;
+            bool stopped = false;
+
+            // only touched on the loop thread
+            std::deque<v8::Global<v8::Promise::Resolver>> waiting;
+    };
+
+    void walkJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        size_t batchSize = DEFAULT_BATCH_SIZE;
+        int maxDepth = -1;
+        if (args.Length() > 1 && args[1]->IsObject()) {
+            v8::Local<v8::Object> opts = args[1].As<v8::Object>();
+            v8::Local<v8::Value> value;
+
+            if (!opts->Get(ctx, v8::String::NewFromUtf8Literal(isolate, "batchSize")).ToLocal(&value)) {
+                return;
+            }
+            if (!value->IsUndefined()) {
+                double size = value->NumberValue(ctx).FromMaybe(0);
+                if (!(size >= 1 && size <= (double) (1 << 24))) {
+                    Senkora::throwException(ctx, "batchSize must be between 1 and 16777216", Senkora::ExceptionType::RANGE);
+                    return;
+                }
+                batchSize = (size_t) size;
+            }
+
+            if (!opts->Get(ctx, v8::String::NewFromUtf8Literal(isolate, "maxDepth")).ToLocal(&value)) {
+                return;
+            }
+            if (!value->IsUndefined()) {
+                double depth = value->NumberValue(ctx).FromMaybe(-1);
+                if (!(depth >= 0)) {
+                    Senkora::throwException(ctx, "maxDepth must be a positive number", Senkora::ExceptionType::RANGE);
+                    return;
+                }
+                maxDepth = depth > (double) INT32_MAX ? -1 : (int) depth;
+            }
+        }
+
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+        std::string root = *pathUtf8;
+        while (root.size() > 1 && root.back() == '/') {
+            root.pop_back();
+        }
+
+        int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+            Senkora::throwException(ctx, "Failed to open directory");
+            return;
+        }
+
+        auto walker = std::make_shared<Walker>(isolate, batchSize, maxDepth);
+        v8::Local<v8::Object> object = newAsyncIterator(ctx, walker);
+        walker->Start(std::make_shared<DirFd>(fd), root == "/" ? "" : root);
+
+        args.GetReturnValue().Set(object);
+    }
+}
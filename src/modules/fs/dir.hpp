@@ -0,0 +1,30 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FS_DIR
+#define FS_DIR
+
+#include <v8.h>
+
+namespace fsMod {
+    // readDir(path), [{ name, type }] without a stat per entry
+    void readDirJS(const v8::FunctionCallbackInfo<v8::Value>& args);
+    // walk(root, { batchSize, maxDepth }), an async iterator of [{ path, type }] batches
+    void walkJS(const v8::FunctionCallbackInfo<v8::Value>& args);
+}
+
+#endif
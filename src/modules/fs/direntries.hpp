@@ -0,0 +1,140 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FS_DIRENTRIES
+#define FS_DIRENTRIES
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Directory reading shared by readDir, walk and deleteDirectory
+namespace fsMod {
+    constexpr size_t DENTS_BUFFER_SIZE = 64 * 1024;
+
+    enum EntryType : uint8_t {
+        UNKNOWN = 0,
+        FILE,
+        DIRECTORY,
+        SYMLINK,
+        BLOCK,
+        CHARACTER,
+        FIFO,
+        SOCKET,
+        ENTRY_TYPES
+    };
+
+    // only read in place in the getdents64 buffer, where each record is
+    // d_reclen long and d_name as long as the name, like glibc's dirent
+    struct linux_dirent64 {
+        ino64_t d_ino;
+        off64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[256];
+    };
+
+    inline EntryType typeFromDirent(unsigned char type) {
+        switch (type) {
+            case DT_REG: return FILE;
+            case DT_DIR: return DIRECTORY;
+            case DT_LNK: return SYMLINK;
+            case DT_BLK: return BLOCK;
+            case DT_CHR: return CHARACTER;
+            case DT_FIFO: return FIFO;
+            case DT_SOCK: return SOCKET;
+            default: return UNKNOWN;
+        }
+    }
+
+    inline EntryType typeFromMode(mode_t mode) {
+        if (S_ISREG(mode)) return FILE;
+        if (S_ISDIR(mode)) return DIRECTORY;
+        if (S_ISLNK(mode)) return SYMLINK;
+        if (S_ISBLK(mode)) return BLOCK;
+        if (S_ISCHR(mode)) return CHARACTER;
+        if (S_ISFIFO(mode)) return FIFO;
+        if (S_ISSOCK(mode)) return SOCKET;
+        return UNKNOWN;
+    }
+
+    // Calls `entry(name, type)` for everything in the open directory `fd`
+    // but . and .., straight from getdents64. Only filesystems that leave
+    // d_type empty cost a stat. False if reading the directory failed.
+    template <typename Callback>
+    bool scanDirectory(int fd, Callback entry) {
+        std::unique_ptr<char[]> buffer(new char[DENTS_BUFFER_SIZE]);
+
+        for (;;) {
+            long count = syscall(SYS_getdents64, fd, buffer.get(), DENTS_BUFFER_SIZE);
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            if (count == -1) {
+                return false;
+            }
+            if (count == 0) {
+                return true;
+            }
+
+            for (long offset = 0; offset < count;) {
+                auto dirent = (struct linux_dirent64 *) (buffer.get() + offset);
+                offset += dirent->d_reclen;
+
+                const char *name = dirent->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+
+                EntryType type = typeFromDirent(dirent->d_type);
+                if (type == UNKNOWN) {
+                    struct stat s;
+                    if (fstatat(fd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+                        type = typeFromMode(s.st_mode);
+                    }
+                }
+
+                entry(name, type);
+            }
+        }
+    }
+
+    // Closes a directory fd when it goes, either with the scope that scans
+    // it or, shared like walk() does, with the last thread that still
+    // openats relative to it.
+    class DirFd {
+        public:
+            explicit DirFd(int fd): fd(fd) {}
+            ~DirFd() {
+                if (this->fd >= 0) {
+                    close(this->fd);
+                }
+            }
+            DirFd(const DirFd&) = delete;
+            DirFd& operator=(const DirFd&) = delete;
+
+            const int fd;
+    };
+}
+
+#endif
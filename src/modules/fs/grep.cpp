@@ -0,0 +1,324 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+extern "C" {
+    #include "api.h"
+}
+#include "grep.hpp"
+#include "batch.hpp"
+#include "scan.hpp"
+#include "../../threadPool.hpp"
+#include "v8-context.h"
+#include "v8-exception.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-promise.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <vector>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace fsMod {
+    constexpr size_t GREP_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    typedef struct {
+        size_t start;
+        size_t end;
+    } LineMatch;
+
+    // A file mapped (or read, where mmap can't) for the whole search,
+    // the matched lines are copied out of it on the loop thread.
+    typedef struct SearchFile {
+        char *data = nullptr;
+        size_t length = 0;
+        bool mapped = false;
+
+        SearchFile() = default;
+        SearchFile(const SearchFile&) = delete;
+        SearchFile& operator=(const SearchFile&) = delete;
+
+        ~SearchFile() {
+            if (this->mapped) {
+                unmapFile(this->data, this->length);
+            } else {
+                free(this->data);
+            }
+        }
+    } SearchFile;
+
+    constexpr size_t NO_NEWLINE = SIZE_MAX;
+
+    // Offsets are into the whole file. A line crossing the chunk's edges
+    // is resolved from the neighbours' newlines, so no chunk scans past
+    // its own bytes looking for one.
+    typedef struct {
+        size_t file;
+        size_t start;
+        size_t end;
+        size_t firstNewline;
+        size_t lastNewline;
+        // where the line running in over `start` begins, and where the one
+        // running out over `end` stops
+        size_t lineStart;
+        size_t lineEnd;
+        std::vector<LineMatch> matches;
+    } SearchChunk;
+
+    class Search {
+        public:
+            Search(std::vector<std::string> paths, std::string needle, size_t maxMatches):
+                paths(std::move(paths)), needle(std::move(needle)), maxMatches(maxMatches) {}
+
+            // thread pool, maps every file, then searches all their chunks at once
+            void Run() {
+                this->files.reset(new SearchFile[this->paths.size()]);
+                events::ParallelFor(this->paths.size(), 1, [this](size_t i) {
+                    this->Load(i);
+                });
+
+                for (size_t i = 0; i < this->paths.size(); i++) {
+                    size_t length = this->files[i].length;
+                    for (size_t start = 0; start < length; start += GREP_CHUNK_SIZE) {
+                        this->chunks.push_back({ i, start, std::min(start + GREP_CHUNK_SIZE, length), NO_NEWLINE, NO_NEWLINE, 0, length, {} });
+                    }
+                }
+
+                events::ParallelFor(this->chunks.size(), 1, [this](size_t i) {
+                    this->FindNewlines(this->chunks[i]);
+                });
+                this->LinkLines();
+
+                events::ParallelFor(this->chunks.size(), 1, [this](size_t i) {
+                    this->Scan(this->chunks[i]);
+                });
+            }
+
+            // empty when a matching line is too long to be a string
+            v8::MaybeLocal<v8::Array> Results(v8::Local<v8::Context> ctx) {
+                v8::Isolate *isolate = ctx->GetIsolate();
+                v8::Local<v8::Array> results = v8::Array::New(isolate);
+                v8::Local<v8::String> pathKey = v8::String::NewFromUtf8Literal(isolate, "path", v8::NewStringType::kInternalized);
+                v8::Local<v8::String> offsetKey = v8::String::NewFromUtf8Literal(isolate, "offset", v8::NewStringType::kInternalized);
+                v8::Local<v8::String> lineKey = v8::String::NewFromUtf8Literal(isolate, "line", v8::NewStringType::kInternalized);
+
+                uint32_t count = 0;
+                size_t lastFile = SIZE_MAX;
+                size_t lastStart = SIZE_MAX;
+                v8::Local<v8::String> path;
+
+                for (auto& chunk : this->chunks) {
+                    const char *data = this->files[chunk.file].data;
+
+                    for (auto& match : chunk.matches) {
+                        if (count >= this->maxMatches) {
+                            return results;
+                        }
+
+                        // a line running over a chunk boundary can be found from both sides
+                        if (chunk.file == lastFile && match.start == lastStart) {
+                            continue;
+                        }
+                        if (chunk.file != lastFile) {
+                            path = v8::String::NewFromUtf8(isolate, this->paths[chunk.file].c_str()).ToLocalChecked();
+                        }
+                        lastFile = chunk.file;
+                        lastStart = match.start;
+
+                        v8::Local<v8::String> line;
+                        size_t length = match.end - match.start;
+                        if (length > (size_t) v8::String::kMaxLength || !v8::String::NewFromUtf8(isolate, data + match.start, v8::NewStringType::kNormal, (int) length).ToLocal(&line)) {
+                            return v8::MaybeLocal<v8::Array>();
+                        }
+
+                        v8::Local<v8::Object> result = v8::Object::New(isolate);
+                        result->Set(ctx, pathKey, path).Check();
+                        result->Set(ctx, offsetKey, v8::Number::New(isolate, (double) match.start)).Check();
+                        result->Set(ctx, lineKey, line).Check();
+                        results->Set(ctx, count++, result).Check();
+                    }
+                }
+
+                return results;
+            }
+
+        private:
+            // unreadable files are skipped, like grep -s
+            void Load(size_t i) {
+                SearchFile& file = this->files[i];
+                void *data;
+                size_t length;
+
+                bool ok = mapFile(this->paths[i].c_str(), &data, &length);
+                if (ok && data != nullptr) {
+                    file.data = (char *) data;
+                    file.length = length;
+                    file.mapped = true;
+                    return;
+                }
+
+                // procfs files report no size, pipes can't be mapped
+                if (ok || data == MAP_FAILED) {
+                    file.data = readFromFile(this->paths[i].c_str(), &file.length);
+                    if (file.data == nullptr) {
+                        file.length = 0;
+                    }
+                }
+            }
+
+            void FindNewlines(SearchChunk& chunk) {
+                const char *data = this->files[chunk.file].data;
+                size_t size = chunk.end - chunk.start;
+
+                const char *first = (const char *) memchr(data + chunk.start, '\n', size);
+                if (first != nullptr) {
+                    chunk.firstNewline = (size_t) (first - data);
+                    chunk.lastNewline = (size_t) ((const char *) memrchr(data + chunk.start, '\n', size) - data);
+                }
+            }
+
+            // one pass each way carries the line edges over chunks without a newline
+            void LinkLines() {
+                for (size_t i = 1; i < this->chunks.size(); i++) {
+                    SearchChunk& previous = this->chunks[i - 1];
+                    if (previous.file == this->chunks[i].file) {
+                        this->chunks[i].lineStart = previous.lastNewline != NO_NEWLINE ? previous.lastNewline + 1 : previous.lineStart;
+                    }
+                }
+
+                for (size_t i = this->chunks.size(); i-- > 1;) {
+                    SearchChunk& next = this->chunks[i];
+                    if (next.file == this->chunks[i - 1].file) {
+                        this->chunks[i - 1].lineEnd = next.firstNewline != NO_NEWLINE ? next.firstNewline : next.lineEnd;
+                    }
+                }
+            }
+
+            // Matches that start inside the chunk, the needle may run past
+            // its end. The search goes on after the line around a match, so
+            // a line is reported once, and at most once more by each chunk
+            // it runs into.
+            void Scan(SearchChunk& chunk) {
+                const char *data = this->files[chunk.file].data;
+                size_t length = this->files[chunk.file].length;
+                const char *needle = this->needle.data();
+                size_t needleLength = this->needle.size();
+
+                size_t window = std::min(length, chunk.end + needleLength - 1);
+                size_t at = chunk.start;
+
+                while (at < chunk.end && chunk.matches.size() < this->maxMatches) {
+                    const char *found = findSubstring(data + at, window - at, needle, needleLength);
+                    if (found == nullptr || (size_t) (found - data) >= chunk.end) {
+                        return;
+                    }
+
+                    size_t position = (size_t) (found - data);
+
+                    LineMatch match;
+                    if (chunk.firstNewline < position) {
+                        const char *before = (const char *) memrchr(data + chunk.start, '\n', position - chunk.start);
+                        match.start = (size_t) (before - data) + 1;
+                    } else {
+                        match.start = chunk.lineStart;
+                    }
+                    if (chunk.lastNewline != NO_NEWLINE && chunk.lastNewline >= position) {
+                        const char *after = (const char *) memchr(found, '\n', chunk.end - position);
+                        match.end = (size_t) (after - data);
+                    } else {
+                        match.end = chunk.lineEnd;
+                    }
+
+                    at = match.end + 1;
+                    if (match.end > match.start && data[match.end - 1] == '\r') {
+                        match.end--;
+                    }
+                    chunk.matches.push_back(match);
+                }
+            }
+
+            std::vector<std::string> paths;
+            std::string needle;
+            // every chunk stops after this many, the first ones overall are among them
+            size_t maxMatches;
+            std::unique_ptr<SearchFile[]> files;
+            std::vector<SearchChunk> chunks;
+    };
+
+    void grepJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 2) {
+            Senkora::throwException(ctx, "Expected 2 arguments");
+            return;
+        }
+
+        std::vector<std::string> paths;
+        if (args[0]->IsString()) {
+            paths.push_back(*v8::String::Utf8Value(isolate, args[0]));
+        } else if (!getPathsArg(ctx, args[0], paths)) {
+            return;
+        }
+
+        if (!args[1]->IsString() || args[1].As<v8::String>()->Length() == 0) {
+            Senkora::throwException(ctx, "Expected argument 2 to be a non-empty string");
+            return;
+        }
+        std::string needle = *v8::String::Utf8Value(isolate, args[1]);
+
+        size_t maxMatches = std::numeric_limits<size_t>::max();
+        if (args.Length() > 2 && args[2]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[2].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8Literal(isolate, "maxMatches")).ToLocal(&value)) {
+                return;
+            }
+            if (!value->IsUndefined()) {
+                double max = value->NumberValue(ctx).FromMaybe(0);
+                if (!(max >= 1)) {
+                    Senkora::throwException(ctx, "maxMatches must be at least 1", Senkora::ExceptionType::RANGE);
+                    return;
+                }
+                maxMatches = max >= 9007199254740991.0 ? maxMatches : (size_t) max;
+            }
+        }
+
+        auto search = std::make_shared<Search>(std::move(paths), std::move(needle), maxMatches);
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [search] { search->Run(); },
+            [search](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                v8::Local<v8::Array> results;
+                if (!search->Results(ctx).ToLocal(&results)) {
+                    v8::Local<v8::String> message = v8::String::NewFromUtf8Literal(ctx->GetIsolate(), "Line too long");
+                    resolver->Reject(ctx, v8::Exception::RangeError(message)).Check();
+                    return;
+                }
+                resolver->Resolve(ctx, results).Check();
+            }));
+    }
+}
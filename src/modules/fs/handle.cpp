@@ -0,0 +1,368 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+extern "C" {
+    #include "api.h"
+}
+#include "handle.hpp"
+#include "mod.hpp"
+#include "v8-array-buffer.h"
+#include "v8-context.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-template.h"
+#include "v8-typed-array.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <memory>
+#include <string>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+// Handle methods are meant for hot loops: reads go straight into the
+// caller's buffers and nothing is allocated unless strings are written.
+namespace fsMod {
+    // what the handle object's internal field points at, closes the file
+    // if the object is collected without close()
+    typedef struct {
+        int fd;
+        v8::Global<v8::Object> object;
+    } FileHandle;
+
+    thread_local v8::Eternal<v8::ObjectTemplate> handleTemplate;
+
+    static bool parseFlags(const std::string& flags, int& result) {
+        size_t i = 1;
+        switch (flags.empty() ? '\0' : flags[0]) {
+            case 'r': result = 0; break;
+            case 'w': result = O_CREAT | O_TRUNC; break;
+            case 'a': result = O_CREAT | O_APPEND; break;
+            default: return false;
+        }
+
+        if (i < flags.size() && flags[i] == 'x' && flags[0] != 'r') {
+            result |= O_EXCL;
+            i++;
+        }
+
+        bool both = i < flags.size() && flags[i] == '+';
+        if (both) {
+            i++;
+        }
+        if (i != flags.size()) {
+            return false;
+        }
+
+        result |= both ? O_RDWR : (flags[0] == 'r' ? O_RDONLY : O_WRONLY);
+        return true;
+    }
+
+    // the open file behind `this`, throws once it has been closed
+    static FileHandle *getHandle(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        FileHandle *handle = (FileHandle *) Senkora::getNativePointer(args.This(), Senkora::NativeType::FILE_HANDLE);
+
+        if (handle == nullptr || handle->fd == -1) {
+            Senkora::throwException(args.GetIsolate()->GetCurrentContext(), "File handle is closed");
+            return nullptr;
+        }
+
+        return handle;
+    }
+
+    // undefined or null is the file position, otherwise a byte offset. Only
+    // a number, converting anything else may run a valueOf() that detaches
+    // the buffers, so this goes before any pointer into them is taken
+    static bool getOffset(const v8::FunctionCallbackInfo<v8::Value>& args, int index, off_t& offset) {
+        offset = -1;
+        if (args.Length() <= index || args[index]->IsNullOrUndefined()) {
+            return true;
+        }
+
+        v8::Local<v8::Context> ctx = args.GetIsolate()->GetCurrentContext();
+        if (!args[index]->IsNumber()) {
+            Senkora::throwException(ctx, "offset must be a number", Senkora::ExceptionType::TYPE);
+            return false;
+        }
+
+        double value = args[index].As<v8::Number>()->Value();
+        if (!(value >= 0 && value <= 9007199254740991.0) || value != (double) (off_t) value) {
+            Senkora::throwException(ctx, "offset must be a positive integer", Senkora::ExceptionType::RANGE);
+            return false;
+        }
+
+        offset = (off_t) value;
+        return true;
+    }
+
+    // the bytes of a view as an iovec, nothing is copied
+    static bool viewChunk(v8::Local<v8::Value> value, struct iovec& chunk) {
+        if (!value->IsArrayBufferView()) {
+            return false;
+        }
+
+        v8::Local<v8::ArrayBufferView> view = value.As<v8::ArrayBufferView>();
+        chunk.iov_base = (char *) view->Buffer()->Data() + view->ByteOffset();
+        chunk.iov_len = view->ByteLength();
+        return true;
+    }
+
+    // read(buffer, offset), bytes read into the view, 0 at the end of the file
+    static void handleRead(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+
+        FileHandle *handle = getHandle(args);
+        if (handle == nullptr) {
+            return;
+        }
+
+        off_t offset;
+        if (!getOffset(args, 1, offset)) {
+            return;
+        }
+
+        struct iovec chunk;
+        if (args.Length() < 1 || !viewChunk(args[0], chunk)) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a TypedArray or DataView", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        ssize_t n;
+        do {
+            n = offset == -1 ? read(handle->fd, chunk.iov_base, chunk.iov_len) : pread(handle->fd, chunk.iov_base, chunk.iov_len, offset);
+        } while (n == -1 && errno == EINTR);
+
+        if (n == -1) {
+            Senkora::throwException(ctx, "Failed to read file");
+            return;
+        }
+
+        args.GetReturnValue().Set((double) n);
+    }
+
+    // readv(buffers, offset), fills the views in order with one preadv
+    static void handleReadv(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+
+        FileHandle *handle = getHandle(args);
+        if (handle == nullptr) {
+            return;
+        }
+
+        if (args.Length() < 1 || !args[0]->IsArray()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be an array of TypedArrays", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        off_t offset;
+        if (!getOffset(args, 1, offset)) {
+            return;
+        }
+
+        std::vector<v8::Local<v8::Value>> items;
+        if (!getItems(ctx, args[0].As<v8::Array>(), items)) {
+            return;
+        }
+
+        uint32_t count = items.size();
+        if (count > IOV_MAX) {
+            Senkora::throwException(ctx, ("Expected at most " + std::to_string(IOV_MAX) + " buffers").c_str(), Senkora::ExceptionType::RANGE);
+            return;
+        }
+
+        struct iovec chunks[IOV_MAX];
+        for (uint32_t i = 0; i < count; i++) {
+            if (!viewChunk(items[i], chunks[i])) {
+                Senkora::throwException(ctx, "Expected argument 1 to be an array of TypedArrays", Senkora::ExceptionType::TYPE);
+                return;
+            }
+        }
+
+        ssize_t n;
+        do {
+            n = offset == -1 ? readv(handle->fd, chunks, (int) count) : preadv(handle->fd, chunks, (int) count, offset);
+        } while (n == -1 && errno == EINTR);
+
+        if (n == -1) {
+            Senkora::throwException(ctx, "Failed to read file");
+            return;
+        }
+
+        args.GetReturnValue().Set((double) n);
+    }
+
+    // write(data, offset) and writev(chunks, offset), everything is written
+    // or it throws, returns the number of bytes
+    static void handleWrite(const v8::FunctionCallbackInfo<v8::Value>& args, bool vectored) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+
+        FileHandle *handle = getHandle(args);
+        if (handle == nullptr) {
+            return;
+        }
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        off_t offset;
+        if (!getOffset(args, 1, offset)) {
+            return;
+        }
+
+        std::vector<struct iovec> chunks;
+        std::vector<std::unique_ptr<v8::String::Utf8Value>> strings;
+
+        if (vectored) {
+            if (!args[0]->IsArray()) {
+                Senkora::throwException(ctx, "Expected argument 1 to be an array", Senkora::ExceptionType::TYPE);
+                return;
+            }
+
+            std::vector<v8::Local<v8::Value>> items;
+            if (!getItems(ctx, args[0].As<v8::Array>(), items)) {
+                return;
+            }
+
+            chunks.reserve(items.size());
+            for (v8::Local<v8::Value> item : items) {
+                if (!addChunk(ctx, item, chunks, strings)) {
+                    Senkora::throwException(ctx, "Expected every chunk to be a string, an ArrayBuffer or a TypedArray", Senkora::ExceptionType::TYPE);
+                    return;
+                }
+            }
+        } else if (!addChunk(ctx, args[0], chunks, strings)) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string, an ArrayBuffer or a TypedArray", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        if (!writeChunksToFd(handle->fd, chunks.data(), (int) chunks.size(), offset)) {
+            Senkora::throwException(ctx, "Failed to write file");
+            return;
+        }
+
+        size_t total = 0;
+        for (auto& chunk : chunks) {
+            total += chunk.iov_len;
+        }
+        args.GetReturnValue().Set((double) total);
+    }
+
+    static void handleWriteOne(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        handleWrite(args, false);
+    }
+
+    static void handleWritev(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        handleWrite(args, true);
+    }
+
+    static void handleFsync(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        FileHandle *handle = getHandle(args);
+        if (handle == nullptr) {
+            return;
+        }
+
+        if (fsync(handle->fd) == -1) {
+            Senkora::throwException(args.GetIsolate()->GetCurrentContext(), "Failed to sync file");
+        }
+    }
+
+    // the object stays around, every call after this throws
+    static void handleClose(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        FileHandle *handle = getHandle(args);
+        if (handle == nullptr) {
+            return;
+        }
+
+        int fd = handle->fd;
+        handle->fd = -1;
+        if (close(fd) == -1 && errno != EINTR) {
+            Senkora::throwException(args.GetIsolate()->GetCurrentContext(), "Failed to close file");
+        }
+    }
+
+    void openJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        int flags = O_RDONLY;
+        if (args.Length() > 1 && !args[1]->IsUndefined()) {
+            v8::String::Utf8Value flagsUtf8(isolate, args[1]);
+            if (!args[1]->IsString() || !parseFlags(*flagsUtf8, flags)) {
+                Senkora::throwException(ctx, "Expected flags to be one of r, r+, w, w+, wx, wx+, a, a+, ax or ax+", Senkora::ExceptionType::TYPE);
+                return;
+            }
+        }
+
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+        int fd = open(*pathUtf8, flags | O_CLOEXEC, 0666);
+        if (fd == -1) {
+            Senkora::throwException(ctx, "Failed to open file");
+            return;
+        }
+
+        if (handleTemplate.IsEmpty()) {
+            v8::Local<v8::ObjectTemplate> tmpl = v8::ObjectTemplate::New(isolate);
+            tmpl->SetInternalFieldCount(Senkora::NATIVE_FIELD_COUNT);
+            tmpl->Set(isolate, "read", v8::FunctionTemplate::New(isolate, handleRead));
+            tmpl->Set(isolate, "readv", v8::FunctionTemplate::New(isolate, handleReadv));
+            tmpl->Set(isolate, "write", v8::FunctionTemplate::New(isolate, handleWriteOne));
+            tmpl->Set(isolate, "writev", v8::FunctionTemplate::New(isolate, handleWritev));
+            tmpl->Set(isolate, "fsync", v8::FunctionTemplate::New(isolate, handleFsync));
+            tmpl->Set(isolate, "close", v8::FunctionTemplate::New(isolate, handleClose));
+            handleTemplate.Set(isolate, tmpl);
+        }
+
+        v8::Local<v8::Object> object = handleTemplate.Get(isolate)->NewInstance(ctx).ToLocalChecked();
+
+        auto handle = new FileHandle();
+        handle->fd = fd;
+        handle->object.Reset(isolate, object);
+        handle->object.SetWeak(handle, [](const v8::WeakCallbackInfo<FileHandle>& info) {
+            FileHandle *handle = info.GetParameter();
+            if (handle->fd != -1) {
+                close(handle->fd);
+            }
+            handle->object.Reset();
+            delete handle;
+        }, v8::WeakCallbackType::kParameter);
+        Senkora::setNativePointer(object, Senkora::NativeType::FILE_HANDLE, handle);
+
+        args.GetReturnValue().Set(object);
+    }
+}
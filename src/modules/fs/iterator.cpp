@@ -0,0 +1,113 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "iterator.hpp"
+#include "v8-context.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-promise.h"
+#include "v8-template.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+namespace fsMod {
+    // what the iterator object's internal field points at, freed with the object
+    typedef struct {
+        std::shared_ptr<AsyncSource> source;
+        v8::Global<v8::Object> object;
+    } SourceHandle;
+
+    thread_local v8::Eternal<v8::ObjectTemplate> iteratorTemplate;
+
+    static AsyncSource *getSource(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        SourceHandle *handle = (SourceHandle *) Senkora::getNativePointer(args.This(), Senkora::NativeType::ASYNC_ITERATOR);
+        return handle != nullptr ? handle->source.get() : nullptr;
+    }
+
+    static void iteratorNext(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+
+        AsyncSource *source = getSource(args);
+        if (source == nullptr) {
+            Senkora::throwException(ctx, "Illegal invocation", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(ctx).ToLocalChecked();
+        source->Next(ctx, resolver);
+        args.GetReturnValue().Set(resolver->GetPromise());
+    }
+
+    // called by for await when the loop is left early
+    static void iteratorReturn(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+
+        AsyncSource *source = getSource(args);
+        if (source == nullptr) {
+            Senkora::throwException(ctx, "Illegal invocation", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        source->Return(ctx);
+
+        v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(ctx).ToLocalChecked();
+        resolver->Resolve(ctx, iterResult(ctx, v8::Undefined(isolate), true)).Check();
+        args.GetReturnValue().Set(resolver->GetPromise());
+    }
+
+    static void iteratorSelf(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        args.GetReturnValue().Set(args.This());
+    }
+
+    v8::Local<v8::Object> newAsyncIterator(v8::Local<v8::Context> ctx, std::shared_ptr<AsyncSource> source) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+
+        if (iteratorTemplate.IsEmpty()) {
+            v8::Local<v8::ObjectTemplate> tmpl = v8::ObjectTemplate::New(isolate);
+            tmpl->SetInternalFieldCount(Senkora::NATIVE_FIELD_COUNT);
+            tmpl->Set(isolate, "next", v8::FunctionTemplate::New(isolate, iteratorNext));
+            tmpl->Set(isolate, "return", v8::FunctionTemplate::New(isolate, iteratorReturn));
+            tmpl->Set(v8::Symbol::GetAsyncIterator(isolate), v8::FunctionTemplate::New(isolate, iteratorSelf));
+            iteratorTemplate.Set(isolate, tmpl);
+        }
+
+        v8::Local<v8::Object> object = iteratorTemplate.Get(isolate)->NewInstance(ctx).ToLocalChecked();
+
+        auto handle = new SourceHandle();
+        handle->source = std::move(source);
+        handle->object.Reset(isolate, object);
+        handle->object.SetWeak(handle, [](const v8::WeakCallbackInfo<SourceHandle>& info) {
+            SourceHandle *handle = info.GetParameter();
+            handle->object.Reset();
+            delete handle;
+        }, v8::WeakCallbackType::kParameter);
+        Senkora::setNativePointer(object, Senkora::NativeType::ASYNC_ITERATOR, handle);
+
+        return object;
+    }
+
+    v8::Local<v8::Object> iterResult(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, bool done) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        v8::Local<v8::Object> result = v8::Object::New(isolate);
+        result->Set(ctx, v8::String::NewFromUtf8(isolate, "value").ToLocalChecked(), value).Check();
+        result->Set(ctx, v8::String::NewFromUtf8(isolate, "done").ToLocalChecked(), v8::Boolean::New(isolate, done)).Check();
+        return result;
+    }
+}
@@ -0,0 +1,43 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FS_ITERATOR
+#define FS_ITERATOR
+
+#include <v8.h>
+#include <memory>
+
+namespace fsMod {
+    // Native side of an async iterator, next() and return() of the JS
+    // object end up here. Sources are shared so work still running on
+    // the thread pool can keep them alive after the object is collected.
+    class AsyncSource : public std::enable_shared_from_this<AsyncSource> {
+        public:
+            virtual ~AsyncSource() = default;
+
+            virtual void Next(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) = 0;
+            // stop early, the following Next calls report done
+            virtual void Return(v8::Local<v8::Context> ctx) = 0;
+    };
+
+    // an object usable with for await, it holds `source` until collected
+    v8::Local<v8::Object> newAsyncIterator(v8::Local<v8::Context> ctx, std::shared_ptr<AsyncSource> source);
+    // { value, done }
+    v8::Local<v8::Object> iterResult(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, bool done);
+}
+
+#endif
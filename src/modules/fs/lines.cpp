@@ -0,0 +1,334 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "lines.hpp"
+#include "iterator.hpp"
+#include "scan.hpp"
+#include "v8-context.h"
+#include "v8-exception.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-promise.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <string.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace fsMod {
+    constexpr size_t DEFAULT_LINE_BATCH = 1024;
+    constexpr size_t LINE_BUFFER_SIZE = 1024 * 1024;
+    constexpr size_t MAX_LINE_LENGTH = v8::String::kMaxLength;
+
+    // The file streams through one buffer: a batch of lines is cut out of
+    // it on the thread pool, turned into strings when JS asks for it, and
+    // only then is the buffer refilled. Memory stays at the buffer plus one
+    // batch, the buffer only grows for lines longer than itself and never
+    // past the longest line that still fits in a string.
+    class LineReader : public AsyncSource {
+        public:
+            LineReader(v8::Isolate *isolate, int fd, size_t batchSize):
+                isolate(isolate), fd(fd), batchSize(batchSize), buffer(LINE_BUFFER_SIZE) {}
+
+            ~LineReader() override {
+                if (this->fd != -1) {
+                    close(this->fd);
+                }
+            }
+
+            // cuts the next batch unless one is being cut or waits for JS
+            void Prefetch() {
+                if (this->reading || this->ready || this->done) {
+                    return;
+                }
+                this->reading = true;
+
+                auto self = std::static_pointer_cast<LineReader>(this->shared_from_this());
+                events::QueueWork(globals.globalLoop.get(), [self] {
+                    self->Fill();
+                }, [self](v8::Local<v8::Context> ctx) {
+                    self->OnFill(ctx);
+                });
+            }
+
+            void Next(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) override {
+                if (this->ready) {
+                    this->Deliver(ctx, resolver);
+                } else if (this->done) {
+                    this->Settle(ctx, resolver);
+                } else {
+                    this->waiting.emplace_back(this->isolate, resolver);
+                    this->Prefetch();
+                }
+            }
+
+            void Return(v8::Local<v8::Context> ctx) override {
+                this->ready = false;
+                this->Finish(ctx);
+            }
+
+        private:
+            // thread pool, the loop thread stays off the buffer meanwhile
+            void Fill() {
+                this->lines.clear();
+
+                // what is left of the last batch moves to the front
+                if (this->start > 0) {
+                    memmove(this->buffer.data(), this->buffer.data() + this->start, this->end - this->start);
+                    this->end -= this->start;
+                    this->scanned -= this->start;
+                    this->start = 0;
+                }
+
+                while (this->lines.size() < this->batchSize) {
+                    this->newlines.clear();
+                    size_t stop = findNewlines(this->buffer.data() + this->scanned, this->end - this->scanned, this->newlines, this->batchSize - this->lines.size());
+
+                    for (size_t at : this->newlines) {
+                        this->Cut(this->scanned + at);
+                    }
+                    this->scanned += stop;
+
+                    if (this->lines.size() == this->batchSize) {
+                        return;
+                    }
+
+                    if (this->eof) {
+                        // the last line doesn't need a newline
+                        if (this->start < this->end) {
+                            this->lines.emplace_back(this->start, this->end - this->start);
+                            this->start = this->end;
+                        }
+                        return;
+                    }
+
+                    if (this->end == this->buffer.size()) {
+                        // lines in the batch point into the buffer, it can only
+                        // be moved around once they have been handed over
+                        if (!this->lines.empty()) {
+                            return;
+                        }
+                        // the buffer holds nothing but the start of this line
+                        if (this->buffer.size() > MAX_LINE_LENGTH) {
+                            this->failed = true;
+                            this->tooLong = true;
+                            return;
+                        }
+                        this->buffer.resize(std::min(this->buffer.size() * 2, MAX_LINE_LENGTH + 1));
+                    }
+
+                    ssize_t n = read(this->fd, this->buffer.data() + this->end, this->buffer.size() - this->end);
+                    if (n == -1 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n == -1) {
+                        this->failed = true;
+                        return;
+                    }
+                    if (n == 0) {
+                        this->eof = true;
+                        continue;
+                    }
+                    this->end += (size_t) n;
+                }
+            }
+
+            // the line from start up to the newline at `at`, "\r\n" counts as one
+            void Cut(size_t at) {
+                size_t length = at - this->start;
+                if (length > 0 && this->buffer[at - 1] == '\r') {
+                    length--;
+                }
+                this->lines.emplace_back(this->start, length);
+                this->start = at + 1;
+            }
+
+            void OnFill(v8::Local<v8::Context> ctx) {
+                this->reading = false;
+
+                if (this->done) {
+                    // return() came in while the batch was being cut
+                    this->Close();
+                    return;
+                }
+
+                if (this->lines.empty()) {
+                    this->Finish(ctx);
+                    return;
+                }
+
+                this->ready = true;
+
+                if (!this->waiting.empty()) {
+                    v8::Local<v8::Promise::Resolver> resolver = this->waiting.front().Get(this->isolate);
+                    this->waiting.pop_front();
+                    this->Deliver(ctx, resolver);
+                }
+            }
+
+            // turns the waiting batch into strings and starts on the next one
+            void Deliver(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                v8::Local<v8::Array> array = v8::Array::New(this->isolate, (int) this->lines.size());
+                const char *data = this->buffer.data();
+
+                for (size_t i = 0; i < this->lines.size(); i++) {
+                    auto [offset, length] = this->lines[i];
+                    v8::Local<v8::String> line;
+                    if (length > MAX_LINE_LENGTH || !v8::String::NewFromUtf8(this->isolate, data + offset, v8::NewStringType::kNormal, (int) length).ToLocal(&line)) {
+                        // the last line of the file can still end up here
+                        this->ready = false;
+                        this->failed = true;
+                        this->tooLong = true;
+                        this->Settle(ctx, resolver);
+                        this->Finish(ctx);
+                        return;
+                    }
+                    array->Set(ctx, (uint32_t) i, line).Check();
+                }
+
+                this->ready = false;
+                // a failure after the last good batch comes with the next call
+                if (this->failed) {
+                    this->Finish(ctx);
+                } else {
+                    this->Prefetch();
+                }
+
+                resolver->Resolve(ctx, iterResult(ctx, array, false)).Check();
+            }
+
+            void Finish(v8::Local<v8::Context> ctx) {
+                this->done = true;
+                if (!this->reading) {
+                    this->Close();
+                }
+
+                while (!this->waiting.empty()) {
+                    v8::Local<v8::Promise::Resolver> resolver = this->waiting.front().Get(this->isolate);
+                    this->waiting.pop_front();
+                    this->Settle(ctx, resolver);
+                }
+            }
+
+            // end of the file, or the error once
+            void Settle(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (this->failed) {
+                    this->failed = false;
+                    if (this->tooLong) {
+                        v8::Local<v8::String> message = v8::String::NewFromUtf8Literal(this->isolate, "Line too long");
+                        resolver->Reject(ctx, v8::Exception::RangeError(message)).Check();
+                        return;
+                    }
+                    v8::Local<v8::String> message = v8::String::NewFromUtf8(this->isolate, "Failed to read file").ToLocalChecked();
+                    resolver->Reject(ctx, v8::Exception::Error(message)).Check();
+                    return;
+                }
+
+                resolver->Resolve(ctx, iterResult(ctx, v8::Undefined(this->isolate), true)).Check();
+            }
+
+            void Close() {
+                if (this->fd != -1) {
+                    close(this->fd);
+                    this->fd = -1;
+                }
+                this->buffer = std::vector<char>();
+            }
+
+            v8::Isolate *isolate;
+            int fd;
+            const size_t batchSize;
+
+            // [start, end) is read but not handed out yet, newlines up to
+            // `scanned` have been found already
+            std::vector<char> buffer;
+            size_t start = 0;
+            size_t end = 0;
+            size_t scanned = 0;
+            bool eof = false;
+            // (offset, length) in the buffer of the lines of the next batch
+            std::vector<std::pair<size_t, size_t>> lines;
+            std::vector<size_t> newlines;
+
+            bool reading = false;
+            bool ready = false;
+            bool done = false;
+            bool failed = false;
+            // what failed is a line that can't be a string
+            bool tooLong = false;
+            std::deque<v8::Global<v8::Promise::Resolver>> waiting;
+    };
+
+    void readLinesJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        size_t batchSize = DEFAULT_LINE_BATCH;
+        if (args.Length() > 1 && args[1]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[1].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8Literal(isolate, "batchSize")).ToLocal(&value)) {
+                return;
+            }
+            if (!value->IsUndefined()) {
+                double size = value->NumberValue(ctx).FromMaybe(0);
+                if (!(size >= 1 && size <= (double) (1 << 24))) {
+                    Senkora::throwException(ctx, "batchSize must be between 1 and 16777216", Senkora::ExceptionType::RANGE);
+                    return;
+                }
+                batchSize = (size_t) size;
+            }
+        }
+
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+        int fd = open(*pathUtf8, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            Senkora::throwException(ctx, "Failed to open file");
+            return;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        auto reader = std::make_shared<LineReader>(isolate, fd, batchSize);
+        v8::Local<v8::Object> object = newAsyncIterator(ctx, reader);
+
+        // the first batch is on its way before anyone asks for it
+        reader->Prefetch();
+
+        args.GetReturnValue().Set(object);
+    }
+}
@@ -19,15 +19,77 @@ extern "C" {
     #include "api.h"
 }
 #include "mod.hpp"
+#include "stream.hpp"
+#include "dir.hpp"
+#include "remove.hpp"
+#include "watch.hpp"
+#include "batch.hpp"
+#include "copy.hpp"
+#include "handle.hpp"
+#include "lines.hpp"
+#include "grep.hpp"
 #include "v8-isolate.h"
 #include "v8-local-handle.h"
 #include "v8-primitive.h"
+#include "v8-array-buffer.h"
+#include "v8-typed-array.h"
 
 #include <v8.h>
 #include <Senkora.hpp>
 #include "../modules.hpp"
 
+#include <memory>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <vector>
+
 namespace fsMod {
+    // Points a chunk at the bytes of a string, ArrayBuffer or view. Buffers
+    // are written from their backing store as they are, strings are encoded
+    // into `strings`, which has to outlive the write.
+    bool addChunk(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, std::vector<struct iovec>& chunks, std::vector<std::unique_ptr<v8::String::Utf8Value>>& strings) {
+        if (value->IsString()) {
+            strings.push_back(std::make_unique<v8::String::Utf8Value>(ctx->GetIsolate(), value));
+            chunks.push_back({ **strings.back(), (size_t) strings.back()->length() });
+            return true;
+        }
+
+        if (value->IsArrayBufferView()) {
+            v8::Local<v8::ArrayBufferView> view = value.As<v8::ArrayBufferView>();
+            char *data = (char *) view->Buffer()->Data();
+            chunks.push_back({ data + view->ByteOffset(), view->ByteLength() });
+            return true;
+        }
+
+        if (value->IsArrayBuffer() || value->IsSharedArrayBuffer()) {
+            std::shared_ptr<v8::BackingStore> store = value->IsArrayBuffer()
+                ? value.As<v8::ArrayBuffer>()->GetBackingStore()
+                : value.As<v8::SharedArrayBuffer>()->GetBackingStore();
+            chunks.push_back({ store->Data(), store->ByteLength() });
+            return true;
+        }
+
+        return false;
+    }
+
+    bool getItems(v8::Local<v8::Context> ctx, v8::Local<v8::Array> array, std::vector<v8::Local<v8::Value>>& items) {
+        uint32_t count = array->Length();
+        items.reserve(count);
+
+        for (uint32_t i = 0; i < count; i++) {
+            v8::Local<v8::Value> item;
+            if (!array->Get(ctx, i).ToLocal(&item)) {
+                return false;
+            }
+            items.push_back(item);
+        }
+
+        return true;
+    }
+
+    // writeToFile(path, data, { append }) where data is a string, an
+    // ArrayBuffer, a TypedArray or an array of those written with one writev
     void writeToFileJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
         v8::Isolate *isolate = args.GetIsolate();
         v8::Isolate::Scope isolateScope(isolate);
@@ -44,18 +106,43 @@ namespace fsMod {
             return;
         }
 
-        if (!args[1]->IsString()) {
-            Senkora::throwException(ctx, "Expected argument 2 to be a string");
+        // getters run here, no chunk points into a buffer yet
+        bool append = false;
+        if (args.Length() > 2 && args[2]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[2].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8(isolate, "append").ToLocalChecked()).ToLocal(&value)) {
+                return;
+            }
+            append = value->BooleanValue(isolate);
+        }
+
+        std::vector<v8::Local<v8::Value>> items;
+        if (args[1]->IsArray() && !getItems(ctx, args[1].As<v8::Array>(), items)) {
             return;
         }
 
-        v8::Local<v8::String> path = args[0]->ToString(ctx).ToLocalChecked();
-        v8::Local<v8::String> content = args[1]->ToString(ctx).ToLocalChecked();
-        
-        v8::String::Utf8Value pathUtf8(isolate, path);
-        v8::String::Utf8Value contentUtf8(isolate, content);
+        std::vector<struct iovec> chunks;
+        std::vector<std::unique_ptr<v8::String::Utf8Value>> strings;
+
+        if (args[1]->IsArray()) {
+            chunks.reserve(items.size());
+            for (v8::Local<v8::Value> item : items) {
+                if (!addChunk(ctx, item, chunks, strings)) {
+                    Senkora::throwException(ctx, "Expected every chunk to be a string, an ArrayBuffer or a TypedArray", Senkora::ExceptionType::TYPE);
+                    return;
+                }
+            }
+        } else if (!addChunk(ctx, args[1], chunks, strings)) {
+            Senkora::throwException(ctx, "Expected argument 2 to be a string, an ArrayBuffer, a TypedArray or an array of them", Senkora::ExceptionType::TYPE);
+            return;
+        }
 
-        writeToFile(*pathUtf8, *contentUtf8);
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+
+        if (!writeChunksToFile(*pathUtf8, chunks.data(), (int) chunks.size(), append)) {
+            Senkora::throwException(ctx, "Failed to write file");
+            return;
+        }
 
         args.GetReturnValue().Set(v8::Undefined(isolate));
     }
@@ -79,9 +166,25 @@ namespace fsMod {
         v8::Local<v8::String> path = args[0]->ToString(ctx).ToLocalChecked();
         v8::String::Utf8Value pathUtf8(isolate, path);
 
-        std::string content = readFromFile(*pathUtf8);
+        size_t length = 0;
+        char *content = readFromFile(*pathUtf8, &length);
+        if (content == nullptr) {
+            Senkora::throwException(ctx, "Failed to read file");
+            return;
+        }
+
+        v8::MaybeLocal<v8::String> str;
+        if (length <= (size_t) v8::String::kMaxLength) {
+            str = v8::String::NewFromUtf8(isolate, content, v8::NewStringType::kNormal, (int) length);
+        }
+        free(content);
+
+        if (str.IsEmpty()) {
+            Senkora::throwException(ctx, "File is too large", Senkora::ExceptionType::RANGE);
+            return;
+        }
 
-        args.GetReturnValue().Set(v8::String::NewFromUtf8(isolate, content.c_str()).ToLocalChecked());
+        args.GetReturnValue().Set(str.ToLocalChecked());
     }
 
     void deleteFileJS(const v8::FunctionCallbackInfo<v8::Value> &args) {
@@ -133,7 +236,7 @@ namespace fsMod {
         v8::Local<v8::String> path = args[0]->ToString(ctx).ToLocalChecked();
         v8::String::Utf8Value pathUtf8(isolate, path);
 
-        if (deleteDirectory(*pathUtf8) == 0) {
+        if (!removeTree(*pathUtf8)) {
             Senkora::throwException(ctx, "Failed to delete directory");
             return;
         }
@@ -141,6 +244,56 @@ namespace fsMod {
         args.GetReturnValue().Set(v8::Undefined(isolate));
     }
 
+    // copyFile(src, dst, { overwrite }) / copyDirectory(src, dst, { overwrite })
+    void copyJS(const v8::FunctionCallbackInfo<v8::Value> &args, bool tree) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 2) {
+            Senkora::throwException(ctx, "Expected 2 arguments");
+            return;
+        }
+
+        if (!args[0]->IsString() || !args[1]->IsString()) {
+            Senkora::throwException(ctx, "Expected arguments 1 and 2 to be strings");
+            return;
+        }
+
+        bool overwrite = true;
+        if (args.Length() > 2 && args[2]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[2].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8(isolate, "overwrite").ToLocalChecked()).ToLocal(&value)) {
+                return;
+            }
+            overwrite = value->IsUndefined() || value->BooleanValue(isolate);
+        }
+
+        v8::String::Utf8Value srcUtf8(isolate, args[0]);
+        v8::String::Utf8Value dstUtf8(isolate, args[1]);
+
+        if (tree) {
+            if (!copyTree(*srcUtf8, *dstUtf8, overwrite)) {
+                Senkora::throwException(ctx, "Failed to copy directory");
+                return;
+            }
+        } else if (!copyFile(*srcUtf8, *dstUtf8, overwrite)) {
+            Senkora::throwException(ctx, "Failed to copy file");
+            return;
+        }
+
+        args.GetReturnValue().Set(v8::Undefined(isolate));
+    }
+
+    void copyFileJS(const v8::FunctionCallbackInfo<v8::Value> &args) {
+        copyJS(args, false);
+    }
+
+    void copyDirectoryJS(const v8::FunctionCallbackInfo<v8::Value> &args) {
+        copyJS(args, true);
+    }
+
     void existsFileJS(const v8::FunctionCallbackInfo<v8::Value> &args) {
         v8::Isolate *isolate = args.GetIsolate();
         v8::Isolate::Scope isolateScope(isolate);
@@ -264,13 +417,80 @@ namespace fsMod {
         args.GetReturnValue().Set(v8::Undefined(isolate));
     }
 
+    // The Uint8Array views the mapping itself, it is unmapped once the
+    // buffer is collected. Files that can't be mapped are read instead,
+    // without a copy either way.
+    void readFileBytesJS(const v8::FunctionCallbackInfo<v8::Value> &args)
+    {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1)
+        {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsString())
+        {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        v8::Local<v8::String> path = args[0]->ToString(ctx).ToLocalChecked();
+        v8::String::Utf8Value pathUtf8(isolate, path);
+
+        void *data = nullptr;
+        size_t length = 0;
+        std::unique_ptr<v8::BackingStore> store;
+
+        if (mapFile(*pathUtf8, &data, &length)) {
+            if (data == nullptr) {
+                store = v8::ArrayBuffer::NewBackingStore(isolate, 0);
+            } else {
+                store = v8::ArrayBuffer::NewBackingStore(data, length, [](void *data, size_t length, [[maybe_unused]] void *deleterData) {
+                    unmapFile(data, length);
+                }, nullptr);
+            }
+        } else if (data == MAP_FAILED) {
+            data = readFromFile(*pathUtf8, &length);
+            if (data != nullptr) {
+                store = v8::ArrayBuffer::NewBackingStore(data, length, [](void *data, [[maybe_unused]] size_t length, [[maybe_unused]] void *deleterData) {
+                    free(data);
+                }, nullptr);
+            }
+        }
+
+        if (!store) {
+            Senkora::throwException(ctx, "Failed to read file");
+            return;
+        }
+
+        v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(isolate, std::move(store));
+        args.GetReturnValue().Set(v8::Uint8Array::New(buffer, 0, length));
+    }
+
     std::vector<v8::Local<v8::String>> getExports(v8::Isolate *isolate) {
         std::vector<v8::Local<v8::String>> exports;
 
         exports.push_back(v8::String::NewFromUtf8(isolate, "writeToFile").ToLocalChecked());
         exports.push_back(v8::String::NewFromUtf8(isolate, "readFromFile").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "readFileBytes").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "open").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "createReadStream").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "readLines").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "grep").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "readDir").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "walk").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "watch").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "statMany").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "readMany").ToLocalChecked());
         exports.push_back(v8::String::NewFromUtf8(isolate, "deleteFile").ToLocalChecked());
         exports.push_back(v8::String::NewFromUtf8(isolate, "deleteDirectory").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "copyFile").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "copyDirectory").ToLocalChecked());
         exports.push_back(v8::String::NewFromUtf8(isolate, "existsFile").ToLocalChecked());
         exports.push_back(v8::String::NewFromUtf8(isolate, "existsDirectory").ToLocalChecked());
         exports.push_back(v8::String::NewFromUtf8(isolate, "exists").ToLocalChecked());
@@ -292,6 +512,46 @@ namespace fsMod {
         val = v8::FunctionTemplate::New(isolate, readFromFileJS)->GetFunction(ctx).ToLocalChecked();
         Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
 
+        name = v8::String::NewFromUtf8(isolate, "readFileBytes").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, readFileBytesJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "open").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, openJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "createReadStream").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, createReadStreamJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "readLines").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, readLinesJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "grep").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, grepJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "readDir").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, readDirJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "walk").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, walkJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "watch").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, watchJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "statMany").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, statManyJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "readMany").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, readManyJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
         name = v8::String::NewFromUtf8(isolate, "deleteFile").ToLocalChecked();
         val = v8::FunctionTemplate::New(isolate, deleteFileJS)->GetFunction(ctx).ToLocalChecked();
         Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
@@ -300,6 +560,14 @@ namespace fsMod {
         val = v8::FunctionTemplate::New(isolate, deleteDirectoryJS)->GetFunction(ctx).ToLocalChecked();
         Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
 
+        name = v8::String::NewFromUtf8(isolate, "copyFile").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, copyFileJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "copyDirectory").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, copyDirectoryJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
         name = v8::String::NewFromUtf8(isolate, "exists").ToLocalChecked();
         val = v8::FunctionTemplate::New(isolate, existsJS)->GetFunction(ctx).ToLocalChecked();
         Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
@@ -22,9 +22,19 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "v8-local-handle.h"
 #include "v8-primitive.h"
 #include <v8.h>
+#include <memory>
+#include <sys/uio.h>
 #include <vector>
 
 namespace fsMod {
+    // Points a chunk at the bytes of a string, ArrayBuffer or view, strings
+    // are encoded into `strings`, which has to outlive the write
+    bool addChunk(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, std::vector<struct iovec>& chunks, std::vector<std::unique_ptr<v8::String::Utf8Value>>& strings);
+
+    // The items of an array, all read before any chunk points into them,
+    // an index getter could detach a buffer that was already collected
+    bool getItems(v8::Local<v8::Context> ctx, v8::Local<v8::Array> array, std::vector<v8::Local<v8::Value>>& items);
+
     std::vector<v8::Local<v8::String>> getExports(v8::Isolate *isolate);
     v8::MaybeLocal<v8::Value> init(v8::Local<v8::Context> ctx, v8::Local<v8::Module> mod);
 }
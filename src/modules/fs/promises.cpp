@@ -0,0 +1,781 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+extern "C" {
+    #include "api.h"
+}
+#include "promises.hpp"
+#include "remove.hpp"
+#include "batch.hpp"
+#include "copy.hpp"
+#include "v8-isolate.h"
+#include "v8-local-handle.h"
+#include "v8-primitive.h"
+#include "v8-promise.h"
+
+#include <v8.h>
+#include <Senkora.hpp>
+#include "../modules.hpp"
+
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+// Every export submits through the loop's io_uring when the kernel supports
+// the opcodes it needs, and runs the synchronous api.c call on the thread
+// pool otherwise. Either way the promise settles from inside events::Run.
+namespace fsPromisesMod {
+    class FsRequest : public events::UringRequest {
+        public:
+            FsRequest(v8::Isolate *isolate, v8::Local<v8::Promise::Resolver> resolver, events::Uring *ring, const std::string& path):
+                resolver(isolate, resolver), ring(ring), path(path) {}
+
+        protected:
+            io_uring_sqe *Sqe() {
+                return this->ring->GetSqe(this);
+            }
+
+            bool Resolve(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value) {
+                this->resolver.Get(ctx->GetIsolate())->Resolve(ctx, value).Check();
+                return false;
+            }
+
+            bool Reject(v8::Local<v8::Context> ctx, const char *message) {
+                v8::Isolate *isolate = ctx->GetIsolate();
+                v8::Local<v8::Value> err = v8::Exception::Error(v8::String::NewFromUtf8(isolate, message).ToLocalChecked());
+                this->resolver.Get(isolate)->Reject(ctx, err).Check();
+                return false;
+            }
+
+            v8::Global<v8::Promise::Resolver> resolver;
+            events::Uring *ring;
+            std::string path;
+    };
+
+    // openat -> statx -> read until EOF -> close
+    class ReadFileRequest : public FsRequest {
+        public:
+            using FsRequest::FsRequest;
+
+            static bool Supported(events::Uring *ring) {
+                return ring->Supports(IORING_OP_OPENAT) && ring->Supports(IORING_OP_STATX)
+                    && ring->Supports(IORING_OP_READ) && ring->Supports(IORING_OP_CLOSE);
+            }
+
+            void Start() {
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uintptr_t) this->path.c_str();
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            }
+
+            bool Complete(v8::Local<v8::Context> ctx, int res) override {
+                switch (this->state) {
+                    case OPEN:
+                        if (res < 0) {
+                            return this->Reject(ctx, "Failed to read file");
+                        }
+                        this->fd = res;
+                        this->PrepareStat();
+                        return true;
+                    case STAT:
+                        if (res < 0) {
+                            return this->Fail();
+                        }
+                        // procfs and friends report 0, read those in chunks
+                        this->expected = this->stx.stx_size;
+                        this->buffer.resize(this->expected > 0 ? this->expected : 65536);
+                        this->PrepareRead();
+                        return true;
+                    case READ:
+                        if (res < 0) {
+                            return this->Fail();
+                        }
+                        this->offset += res;
+                        if (res == 0 || (this->expected > 0 && this->offset == this->expected)) {
+                            this->buffer.resize(this->offset);
+                            this->PrepareClose();
+                            return true;
+                        }
+                        if (this->offset == this->buffer.size()) {
+                            this->buffer.resize(this->buffer.size() * 2);
+                        }
+                        this->PrepareRead();
+                        return true;
+                    case CLOSE:
+                        break;
+                }
+
+                if (this->failed) {
+                    return this->Reject(ctx, "Failed to read file");
+                }
+
+                // the length V8 takes is an int, so this goes first
+                if (this->buffer.size() > (size_t) v8::String::kMaxLength) {
+                    return this->Reject(ctx, "File is too large");
+                }
+
+                v8::MaybeLocal<v8::String> str = v8::String::NewFromUtf8(ctx->GetIsolate(), this->buffer.data(), v8::NewStringType::kNormal, (int) this->buffer.size());
+                if (str.IsEmpty()) {
+                    return this->Reject(ctx, "File is too large");
+                }
+
+                return this->Resolve(ctx, str.ToLocalChecked());
+            }
+
+        private:
+            void PrepareStat() {
+                this->state = STAT;
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = this->fd;
+                sqe->addr = (uintptr_t) "";
+                sqe->len = STATX_SIZE;
+                sqe->off = (uintptr_t) &this->stx;
+                sqe->statx_flags = AT_EMPTY_PATH;
+            }
+
+            void PrepareRead() {
+                this->state = READ;
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = this->fd;
+                sqe->addr = (uintptr_t) (this->buffer.data() + this->offset);
+                sqe->len = (unsigned) std::min(this->buffer.size() - this->offset, (size_t) 1 << 30);
+                sqe->off = this->offset;
+            }
+
+            void PrepareClose() {
+                this->state = CLOSE;
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = this->fd;
+            }
+
+            bool Fail() {
+                this->failed = true;
+                this->PrepareClose();
+                return true;
+            }
+
+            enum { OPEN, STAT, READ, CLOSE } state = OPEN;
+            int fd = -1;
+            bool failed = false;
+            struct statx stx = {};
+            size_t expected = 0;
+            size_t offset = 0;
+            std::string buffer;
+    };
+
+    // openat -> write until everything is out -> close
+    class WriteFileRequest : public FsRequest {
+        public:
+            WriteFileRequest(v8::Isolate *isolate, v8::Local<v8::Promise::Resolver> resolver, events::Uring *ring, const std::string& path, std::string content):
+                FsRequest(isolate, resolver, ring, path), content(std::move(content)) {}
+
+            static bool Supported(events::Uring *ring) {
+                return ring->Supports(IORING_OP_OPENAT) && ring->Supports(IORING_OP_WRITE) && ring->Supports(IORING_OP_CLOSE);
+            }
+
+            void Start() {
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uintptr_t) this->path.c_str();
+                sqe->len = 0666;
+                sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            }
+
+            bool Complete(v8::Local<v8::Context> ctx, int res) override {
+                switch (this->state) {
+                    case OPEN:
+                        if (res < 0) {
+                            return this->Reject(ctx, "Failed to write file");
+                        }
+                        this->fd = res;
+                        this->PrepareWrite();
+                        return true;
+                    case WRITE:
+                        if (res < 0) {
+                            this->failed = true;
+                            this->PrepareClose();
+                            return true;
+                        }
+                        this->offset += res;
+                        this->PrepareWrite();
+                        return true;
+                    case CLOSE:
+                        break;
+                }
+
+                if (this->failed) {
+                    return this->Reject(ctx, "Failed to write file");
+                }
+
+                return this->Resolve(ctx, v8::Undefined(ctx->GetIsolate()));
+            }
+
+        private:
+            void PrepareWrite() {
+                if (this->offset == this->content.size()) {
+                    this->PrepareClose();
+                    return;
+                }
+
+                this->state = WRITE;
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = this->fd;
+                sqe->addr = (uintptr_t) (this->content.data() + this->offset);
+                sqe->len = (unsigned) std::min(this->content.size() - this->offset, (size_t) 1 << 30);
+                sqe->off = this->offset;
+            }
+
+            void PrepareClose() {
+                this->state = CLOSE;
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = this->fd;
+            }
+
+            enum { OPEN, WRITE, CLOSE } state = OPEN;
+            int fd = -1;
+            bool failed = false;
+            size_t offset = 0;
+            std::string content;
+    };
+
+    enum class StatKind {
+        ANY,
+        FILE,
+        DIRECTORY
+    };
+
+    class StatRequest : public FsRequest {
+        public:
+            StatRequest(v8::Isolate *isolate, v8::Local<v8::Promise::Resolver> resolver, events::Uring *ring, const std::string& path, StatKind kind):
+                FsRequest(isolate, resolver, ring, path), kind(kind) {}
+
+            static bool Supported(events::Uring *ring) {
+                return ring->Supports(IORING_OP_STATX);
+            }
+
+            void Start() {
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_STATX;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uintptr_t) this->path.c_str();
+                sqe->len = STATX_TYPE;
+                sqe->off = (uintptr_t) &this->stx;
+            }
+
+            bool Complete(v8::Local<v8::Context> ctx, int res) override {
+                bool found = res == 0;
+                if (found && this->kind == StatKind::FILE) {
+                    found = !S_ISDIR(this->stx.stx_mode);
+                } else if (found && this->kind == StatKind::DIRECTORY) {
+                    found = S_ISDIR(this->stx.stx_mode);
+                }
+
+                return this->Resolve(ctx, v8::Boolean::New(ctx->GetIsolate(), found));
+            }
+
+        private:
+            StatKind kind;
+            struct statx stx = {};
+    };
+
+    class UnlinkRequest : public FsRequest {
+        public:
+            using FsRequest::FsRequest;
+
+            static bool Supported(events::Uring *ring) {
+                return ring->Supports(IORING_OP_UNLINKAT);
+            }
+
+            void Start() {
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_UNLINKAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uintptr_t) this->path.c_str();
+            }
+
+            bool Complete(v8::Local<v8::Context> ctx, int res) override {
+                if (res < 0) {
+                    return this->Reject(ctx, "Failed to delete file");
+                }
+
+                return this->Resolve(ctx, v8::Undefined(ctx->GetIsolate()));
+            }
+    };
+
+    class MkdirRequest : public FsRequest {
+        public:
+            using FsRequest::FsRequest;
+
+            static bool Supported(events::Uring *ring) {
+                return ring->Supports(IORING_OP_MKDIRAT);
+            }
+
+            void Start() {
+                io_uring_sqe *sqe = this->Sqe();
+                sqe->opcode = IORING_OP_MKDIRAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (uintptr_t) this->path.c_str();
+                sqe->len = 0777;
+            }
+
+            bool Complete(v8::Local<v8::Context> ctx, int res) override {
+                if (res < 0) {
+                    return this->Reject(ctx, "Failed to create directory");
+                }
+
+                return this->Resolve(ctx, v8::Undefined(ctx->GetIsolate()));
+            }
+    };
+
+    // Starts `Request` on the ring if it can take it, returns false when the
+    // caller should use the thread pool instead.
+    template <typename Request, typename... Args>
+    bool startOnRing(const v8::FunctionCallbackInfo<v8::Value>& args, v8::Local<v8::Context> ctx, const std::string& path, Args&&... extra) {
+        events::EventLoop *loop = globals.globalLoop.get();
+        events::Uring *ring = events::ReserveUring(loop);
+        if (ring == nullptr) {
+            return false;
+        }
+
+        if (!Request::Supported(ring)) {
+            events::FinishUring(loop);
+            return false;
+        }
+
+        v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(ctx).ToLocalChecked();
+        auto request = new Request(ctx->GetIsolate(), resolver, ring, path, std::forward<Args>(extra)...);
+        request->Start();
+
+        args.GetReturnValue().Set(resolver->GetPromise());
+        return true;
+    }
+
+    void rejectWith(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver, const char *message) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        resolver->Reject(ctx, v8::Exception::Error(v8::String::NewFromUtf8(isolate, message).ToLocalChecked())).Check();
+    }
+
+    bool getPathArg(const v8::FunctionCallbackInfo<v8::Value>& args, v8::Local<v8::Context> ctx, std::string& path) {
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return false;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return false;
+        }
+
+        v8::String::Utf8Value pathUtf8(ctx->GetIsolate(), args[0]);
+        path = *pathUtf8;
+        return true;
+    }
+
+    void writeToFileJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 2) {
+            Senkora::throwException(ctx, "Expected 2 arguments");
+            return;
+        }
+
+        if (!args[1]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 2 to be a string");
+            return;
+        }
+
+        std::string path;
+        if (!getPathArg(args, ctx, path)) {
+            return;
+        }
+
+        v8::String::Utf8Value contentUtf8(isolate, args[1]);
+        std::string content(*contentUtf8, contentUtf8.length());
+
+        if (startOnRing<WriteFileRequest>(args, ctx, path, std::move(content))) {
+            return;
+        }
+
+        auto ok = std::make_shared<int>(0);
+        auto data = std::make_shared<std::string>(std::move(content));
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [path, data, ok] { *ok = writeToFile(path.c_str(), data->data(), data->size(), 0); },
+            [ok](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (!*ok) {
+                    rejectWith(ctx, resolver, "Failed to write file");
+                    return;
+                }
+                resolver->Resolve(ctx, v8::Undefined(ctx->GetIsolate())).Check();
+            }));
+    }
+
+    void readFromFileJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        std::string path;
+        if (!getPathArg(args, ctx, path)) {
+            return;
+        }
+
+        if (startOnRing<ReadFileRequest>(args, ctx, path)) {
+            return;
+        }
+
+        auto content = std::make_shared<std::pair<char *, size_t>>(nullptr, 0);
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [path, content] { content->first = readFromFile(path.c_str(), &content->second); },
+            [content](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (content->first == nullptr) {
+                    rejectWith(ctx, resolver, "Failed to read file");
+                    return;
+                }
+
+                v8::MaybeLocal<v8::String> str;
+                if (content->second <= (size_t) v8::String::kMaxLength) {
+                    str = v8::String::NewFromUtf8(ctx->GetIsolate(), content->first, v8::NewStringType::kNormal, (int) content->second);
+                }
+                free(content->first);
+
+                if (str.IsEmpty()) {
+                    rejectWith(ctx, resolver, "File is too large");
+                    return;
+                }
+                resolver->Resolve(ctx, str.ToLocalChecked()).Check();
+            }));
+    }
+
+    void deleteFileJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        std::string path;
+        if (!getPathArg(args, ctx, path)) {
+            return;
+        }
+
+        if (startOnRing<UnlinkRequest>(args, ctx, path)) {
+            return;
+        }
+
+        auto ok = std::make_shared<int>(0);
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [path, ok] { *ok = deleteFile(path.c_str()); },
+            [ok](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (!*ok) {
+                    rejectWith(ctx, resolver, "Failed to delete file");
+                    return;
+                }
+                resolver->Resolve(ctx, v8::Undefined(ctx->GetIsolate())).Check();
+            }));
+    }
+
+    // spreads over the pool itself, so never on the ring
+    void deleteDirectoryJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        std::string path;
+        if (!getPathArg(args, ctx, path)) {
+            return;
+        }
+
+        auto ok = std::make_shared<int>(0);
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [path, ok] { *ok = fsMod::removeTree(path); },
+            [ok](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (!*ok) {
+                    rejectWith(ctx, resolver, "Failed to delete directory");
+                    return;
+                }
+                resolver->Resolve(ctx, v8::Undefined(ctx->GetIsolate())).Check();
+            }));
+    }
+
+    // copies never go on the ring, copyFile lets the kernel move the data
+    // and copyDirectory spreads over the pool itself
+    void copyJS(const v8::FunctionCallbackInfo<v8::Value>& args, bool tree) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 2) {
+            Senkora::throwException(ctx, "Expected 2 arguments");
+            return;
+        }
+
+        if (!args[0]->IsString() || !args[1]->IsString()) {
+            Senkora::throwException(ctx, "Expected arguments 1 and 2 to be strings");
+            return;
+        }
+
+        bool overwrite = true;
+        if (args.Length() > 2 && args[2]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[2].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8(isolate, "overwrite").ToLocalChecked()).ToLocal(&value)) {
+                return;
+            }
+            overwrite = value->IsUndefined() || value->BooleanValue(isolate);
+        }
+
+        std::string src = *v8::String::Utf8Value(isolate, args[0]);
+        std::string dst = *v8::String::Utf8Value(isolate, args[1]);
+
+        auto ok = std::make_shared<int>(0);
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [src, dst, overwrite, tree, ok] {
+                *ok = tree ? fsMod::copyTree(src, dst, overwrite) : copyFile(src.c_str(), dst.c_str(), overwrite);
+            },
+            [ok, tree](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (!*ok) {
+                    rejectWith(ctx, resolver, tree ? "Failed to copy directory" : "Failed to copy file");
+                    return;
+                }
+                resolver->Resolve(ctx, v8::Undefined(ctx->GetIsolate())).Check();
+            }));
+    }
+
+    void copyFileJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        copyJS(args, false);
+    }
+
+    void copyDirectoryJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        copyJS(args, true);
+    }
+
+    void statJS(const v8::FunctionCallbackInfo<v8::Value>& args, StatKind kind) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        std::string path;
+        if (!getPathArg(args, ctx, path)) {
+            return;
+        }
+
+        if (startOnRing<StatRequest>(args, ctx, path, kind)) {
+            return;
+        }
+
+        auto found = std::make_shared<int>(0);
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [path, found, kind] {
+                switch (kind) {
+                    case StatKind::FILE:
+                        *found = existsFile(path.c_str());
+                        break;
+                    case StatKind::DIRECTORY:
+                        *found = existsDirectory(path.c_str());
+                        break;
+                    default:
+                        *found = exists(path.c_str());
+                        break;
+                }
+            },
+            [found](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                resolver->Resolve(ctx, v8::Boolean::New(ctx->GetIsolate(), *found)).Check();
+            }));
+    }
+
+    // one pool job fanning out over the rest of the pool
+    void statManyJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        auto paths = std::make_shared<std::vector<std::string>>();
+        if (!fsMod::getPathsArg(ctx, args[0], *paths)) {
+            return;
+        }
+
+        auto batch = std::make_shared<fsMod::StatBatch>(fsMod::newStatBatch(isolate, paths->size()));
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [paths, batch] { fsMod::statPaths(*paths, *batch); },
+            [batch](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                resolver->Resolve(ctx, fsMod::statBatchToObject(ctx, *batch)).Check();
+            }));
+    }
+
+    void readManyJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        auto paths = std::make_shared<std::vector<std::string>>();
+        if (!fsMod::getPathsArg(ctx, args[0], *paths)) {
+            return;
+        }
+
+        auto files = std::make_shared<std::vector<fsMod::FileContent>>();
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [paths, files] { fsMod::readPaths(*paths, *files); },
+            [files](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                resolver->Resolve(ctx, fsMod::filesToArray(ctx, *files)).Check();
+            }));
+    }
+
+    void existsJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        statJS(args, StatKind::ANY);
+    }
+
+    void existsFileJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        statJS(args, StatKind::FILE);
+    }
+
+    void existsDirectoryJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        statJS(args, StatKind::DIRECTORY);
+    }
+
+    void createDirectoryJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        std::string path;
+        if (!getPathArg(args, ctx, path)) {
+            return;
+        }
+
+        if (startOnRing<MkdirRequest>(args, ctx, path)) {
+            return;
+        }
+
+        auto ok = std::make_shared<int>(0);
+        args.GetReturnValue().Set(events::QueueWorkPromise(globals.globalLoop.get(), ctx,
+            [path, ok] { *ok = createDirectory(path.c_str()); },
+            [ok](v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (!*ok) {
+                    rejectWith(ctx, resolver, "Failed to create directory");
+                    return;
+                }
+                resolver->Resolve(ctx, v8::Undefined(ctx->GetIsolate())).Check();
+            }));
+    }
+
+    std::vector<v8::Local<v8::String>> getExports(v8::Isolate *isolate) {
+        std::vector<v8::Local<v8::String>> exports;
+
+        exports.push_back(v8::String::NewFromUtf8(isolate, "writeToFile").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "readFromFile").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "deleteFile").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "deleteDirectory").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "copyFile").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "copyDirectory").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "existsFile").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "existsDirectory").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "exists").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "createDirectory").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "statMany").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "readMany").ToLocalChecked());
+        exports.push_back(v8::String::NewFromUtf8(isolate, "default").ToLocalChecked());
+        return exports;
+    }
+
+    v8::MaybeLocal<v8::Value> init(v8::Local<v8::Context> ctx, v8::Local<v8::Module> mod) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+
+        v8::Local<v8::Object> default_exports = v8::Object::New(isolate);
+
+        v8::Local<v8::String> name = v8::String::NewFromUtf8(isolate, "writeToFile").ToLocalChecked();
+        v8::Local<v8::Value> val = v8::FunctionTemplate::New(isolate, writeToFileJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "readFromFile").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, readFromFileJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "deleteFile").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, deleteFileJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "deleteDirectory").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, deleteDirectoryJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "copyFile").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, copyFileJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "copyDirectory").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, copyDirectoryJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "exists").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, existsJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "existsFile").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, existsFileJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "existsDirectory").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, existsDirectoryJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "createDirectory").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, createDirectoryJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "statMany").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, statManyJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        name = v8::String::NewFromUtf8(isolate, "readMany").ToLocalChecked();
+        val = v8::FunctionTemplate::New(isolate, readManyJS)->GetFunction(ctx).ToLocalChecked();
+        Senkora::Modules::setModuleExport(mod, ctx, default_exports, isolate, name, val);
+
+        // default module export
+        Senkora::Modules::setModuleExport(mod, ctx, isolate, v8::String::NewFromUtf8(isolate, "default").ToLocalChecked(), default_exports);
+
+        return v8::Boolean::New(isolate, true);
+    }
+}
@@ -0,0 +1,32 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FS_PROMISES_MODULE
+#define FS_PROMISES_MODULE
+
+#include <v8-isolate.h>
+#include "v8-local-handle.h"
+#include "v8-primitive.h"
+#include <v8.h>
+#include <vector>
+
+namespace fsPromisesMod {
+    std::vector<v8::Local<v8::String>> getExports(v8::Isolate *isolate);
+    v8::MaybeLocal<v8::Value> init(v8::Local<v8::Context> ctx, v8::Local<v8::Module> mod);
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "remove.hpp"
+#include "direntries.hpp"
+#include "../../threadPool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace fsMod {
+    // A directory being emptied. Its children openat/unlinkat relative to
+    // fd, so it stays open until the last of them is done, then the
+    // directory itself goes from its parent. Taking the newest directory
+    // first keeps that to the directories on the way down, not a level.
+    typedef struct Node {
+        std::shared_ptr<struct Node> parent;
+        std::string name;
+        int fd = -1;
+        // its own scan plus one per subdirectory still being emptied
+        std::atomic<int> pending{1};
+    } Node;
+
+    class TreeRemover : public std::enable_shared_from_this<TreeRemover> {
+        public:
+            bool Remove(const std::string& path) {
+                // stands in for the parent of the root
+                auto cwd = std::make_shared<Node>();
+                cwd->fd = AT_FDCWD;
+
+                auto root = std::make_shared<Node>();
+                root->parent = cwd;
+                root->name = path;
+                this->queue.push_back(root);
+
+                // helpers that only get a thread once everything is done return right away
+                size_t helpers = events::GetThreadPool().Size();
+                auto self = this->shared_from_this();
+                for (size_t i = 0; i < helpers; i++) {
+                    events::GetThreadPool().Submit([self] {
+                        self->Work();
+                    });
+                }
+
+                this->Work();
+
+                return !this->failed;
+            }
+
+        private:
+            // takes directories off the queue until there are none left and
+            // nobody is still scanning one that could add more. Newest first,
+            // so a directory's subdirectories are done before its siblings
+            // are opened
+            void Work() {
+                std::unique_lock<std::mutex> lock(this->mutex);
+
+                for (;;) {
+                    this->cond.wait(lock, [this] {
+                        return !this->queue.empty() || this->active == 0;
+                    });
+
+                    if (this->queue.empty()) {
+                        return;
+                    }
+
+                    std::shared_ptr<Node> node = std::move(this->queue.back());
+                    this->queue.pop_back();
+                    this->active++;
+
+                    lock.unlock();
+                    this->Empty(node);
+                    lock.lock();
+
+                    this->active--;
+                    if (this->active == 0 && this->queue.empty()) {
+                        this->cond.notify_all();
+                    }
+                }
+            }
+
+            void Empty(std::shared_ptr<Node> node) {
+                node->fd = openat(node->parent->fd, node->name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (node->fd == -1) {
+                    // a symlink (the root, or a directory swapped for one
+                    // since its parent was scanned) or no directory at all
+                    bool unlinked = (errno == ELOOP || errno == ENOTDIR) && unlinkat(node->parent->fd, node->name.c_str(), 0) == 0;
+                    if (!unlinked) {
+                        this->failed = true;
+                    }
+                    this->Release(node, unlinked);
+                    return;
+                }
+
+                bool ok = scanDirectory(node->fd, [this, &node](const char *name, EntryType type) {
+                    if (type != DIRECTORY) {
+                        if (unlinkat(node->fd, name, 0) == -1 && errno != ENOENT) {
+                            this->failed = true;
+                        }
+                        return;
+                    }
+
+                    auto child = std::make_shared<Node>();
+                    child->parent = node;
+                    child->name = name;
+                    node->pending++;
+
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->queue.push_back(std::move(child));
+                    this->cond.notify_one();
+                });
+
+                if (!ok) {
+                    this->failed = true;
+                }
+
+                this->Release(node, false);
+            }
+
+            // the last one out removes the directory, and maybe its parent,
+            // `removed` when the node itself is already gone
+            void Release(std::shared_ptr<Node> node, bool removed) {
+                while (node->parent && --node->pending == 0) {
+                    if (node->fd != -1) {
+                        close(node->fd);
+                        node->fd = -1;
+                    }
+
+                    if (!removed && unlinkat(node->parent->fd, node->name.c_str(), AT_REMOVEDIR) == -1 && errno != ENOENT) {
+                        this->failed = true;
+                    }
+
+                    removed = false;
+                    node = node->parent;
+                }
+            }
+
+            std::mutex mutex;
+            std::condition_variable cond;
+            std::deque<std::shared_ptr<Node>> queue;
+            size_t active = 0;
+            std::atomic<bool> failed{false};
+    };
+
+    bool removeTree(const std::string& path) {
+        return std::make_shared<TreeRemover>()->Remove(path);
+    }
+}
@@ -0,0 +1,31 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FS_REMOVE
+#define FS_REMOVE
+
+#include <string>
+
+namespace fsMod {
+    // Deletes `path` and everything below it, spread over the calling
+    // thread and the thread pool. False if anything couldn't be removed,
+    // the rest is removed regardless. Symlinks are removed, never followed,
+    // and a `path` that isn't a directory is unlinked.
+    bool removeTree(const std::string& path);
+}
+
+#endif
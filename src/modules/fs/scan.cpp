@@ -0,0 +1,190 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "scan.hpp"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace fsMod {
+    typedef size_t (*NewlineScanner)(const char *data, size_t length, std::vector<size_t>& positions, size_t limit);
+    typedef const char *(*SubstringScanner)(const char *data, size_t length, const char *needle, size_t needleLength);
+
+    static size_t newlinesScalar(const char *data, size_t from, size_t length, std::vector<size_t>& positions, size_t limit) {
+        for (size_t i = from; i < length; i++) {
+            if (data[i] == '\n') {
+                positions.push_back(i);
+                if (positions.size() >= limit) {
+                    return i + 1;
+                }
+            }
+        }
+        return length;
+    }
+
+#if defined(__x86_64__)
+    // one compare per block, then a bit per newline in the mask
+    __attribute__((target("sse2")))
+    static size_t newlinesSse2(const char *data, size_t length, std::vector<size_t>& positions, size_t limit) {
+        const __m128i newline = _mm_set1_epi8('\n');
+        size_t i = 0;
+
+        for (; i + 16 <= length; i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+            unsigned mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+
+            while (mask != 0) {
+                size_t at = i + (size_t) __builtin_ctz(mask);
+                positions.push_back(at);
+                if (positions.size() >= limit) {
+                    return at + 1;
+                }
+                mask &= mask - 1;
+            }
+        }
+
+        return newlinesScalar(data, i, length, positions, limit);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t newlinesAvx2(const char *data, size_t length, std::vector<size_t>& positions, size_t limit) {
+        const __m256i newline = _mm256_set1_epi8('\n');
+        size_t i = 0;
+
+        for (; i + 32 <= length; i += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i *) (data + i));
+            unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline));
+
+            while (mask != 0) {
+                size_t at = i + (size_t) __builtin_ctz(mask);
+                positions.push_back(at);
+                if (positions.size() >= limit) {
+                    return at + 1;
+                }
+                mask &= mask - 1;
+            }
+        }
+
+        return newlinesScalar(data, i, length, positions, limit);
+    }
+
+    // Compares every position with the first and the last byte of the
+    // needle at once, only where both match is the middle memcmp'd.
+    // Needles of two bytes and up, the caller sorts out the rest.
+    __attribute__((target("sse2")))
+    static const char *substringSse2(const char *data, size_t length, const char *needle, size_t needleLength) {
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[needleLength - 1]);
+        size_t i = 0;
+
+        for (; i + needleLength - 1 + 16 <= length; i += 16) {
+            __m128i blockFirst = _mm_loadu_si128((const __m128i *) (data + i));
+            __m128i blockLast = _mm_loadu_si128((const __m128i *) (data + i + needleLength - 1));
+            unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+
+            while (mask != 0) {
+                size_t at = i + (size_t) __builtin_ctz(mask);
+                if (memcmp(data + at + 1, needle + 1, needleLength - 2) == 0) {
+                    return data + at;
+                }
+                mask &= mask - 1;
+            }
+        }
+
+        return (const char *) memmem(data + i, length - i, needle, needleLength);
+    }
+
+    __attribute__((target("avx2")))
+    static const char *substringAvx2(const char *data, size_t length, const char *needle, size_t needleLength) {
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[needleLength - 1]);
+        size_t i = 0;
+
+        for (; i + needleLength - 1 + 32 <= length; i += 32) {
+            __m256i blockFirst = _mm256_loadu_si256((const __m256i *) (data + i));
+            __m256i blockLast = _mm256_loadu_si256((const __m256i *) (data + i + needleLength - 1));
+            unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+
+            while (mask != 0) {
+                size_t at = i + (size_t) __builtin_ctz(mask);
+                if (memcmp(data + at + 1, needle + 1, needleLength - 2) == 0) {
+                    return data + at;
+                }
+                mask &= mask - 1;
+            }
+        }
+
+        return (const char *) memmem(data + i, length - i, needle, needleLength);
+    }
+#else
+    static size_t newlinesPortable(const char *data, size_t length, std::vector<size_t>& positions, size_t limit) {
+        return newlinesScalar(data, 0, length, positions, limit);
+    }
+#endif
+
+    static NewlineScanner pickNewlineScanner() {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return newlinesAvx2;
+        }
+        return newlinesSse2;
+#else
+        return newlinesPortable;
+#endif
+    }
+
+    static SubstringScanner pickSubstringScanner() {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return substringAvx2;
+        }
+        return substringSse2;
+#else
+        return [](const char *data, size_t length, const char *needle, size_t needleLength) {
+            return (const char *) memmem(data, length, needle, needleLength);
+        };
+#endif
+    }
+
+    size_t findNewlines(const char *data, size_t length, std::vector<size_t>& positions, size_t limit) {
+        static const NewlineScanner scanner = pickNewlineScanner();
+        if (positions.size() >= limit) {
+            return 0;
+        }
+        return scanner(data, length, positions, limit);
+    }
+
+    const char *findSubstring(const char *data, size_t length, const char *needle, size_t needleLength) {
+        static const SubstringScanner scanner = pickSubstringScanner();
+
+        if (needleLength == 0) {
+            return data;
+        }
+        if (needleLength > length) {
+            return nullptr;
+        }
+        if (needleLength == 1) {
+            return (const char *) memchr(data, needle[0], length);
+        }
+        return scanner(data, length, needle, needleLength);
+    }
+}
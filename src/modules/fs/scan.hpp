@@ -0,0 +1,36 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FS_SCAN
+#define FS_SCAN
+
+#include <cstddef>
+#include <vector>
+
+// Byte scanning kernels, AVX2 or SSE2 where the CPU has them (picked once
+// at runtime, the build doesn't need -mavx2) and plain loops elsewhere.
+namespace fsMod {
+    // Appends the offset of every '\n' in `data` to `positions` until it
+    // holds `limit` of them. Returns how far it got: past the last newline
+    // it took when the limit was hit, `length` otherwise.
+    size_t findNewlines(const char *data, size_t length, std::vector<size_t>& positions, size_t limit);
+
+    // memmem: the first occurrence of `needle` in `data`, nullptr if there is none
+    const char *findSubstring(const char *data, size_t length, const char *needle, size_t needleLength);
+}
+
+#endif
@@ -0,0 +1,247 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "stream.hpp"
+#include "iterator.hpp"
+#include "v8-array-buffer.h"
+#include "v8-context.h"
+#include "v8-exception.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-promise.h"
+#include "v8-typed-array.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace fsMod {
+    constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+    constexpr size_t MAX_CHUNK_SIZE = 1 << 30;
+
+    // At most one chunk is being read on the thread pool and one waits to
+    // be picked up, so memory stays at two chunks whatever the file size.
+    class ReadStream : public AsyncSource {
+        public:
+            ReadStream(v8::Isolate *isolate, int fd, size_t chunkSize, bool seekable):
+                isolate(isolate), fd(fd), chunkSize(chunkSize), seekable(seekable) {}
+
+            ~ReadStream() override {
+                if (this->fd != -1) {
+                    close(this->fd);
+                }
+            }
+
+            // reads the next chunk in the background unless one is on its way or waiting
+            void Prefetch() {
+                if (this->reading || this->ready || this->done) {
+                    return;
+                }
+                this->reading = true;
+
+                std::shared_ptr<v8::BackingStore> store = v8::ArrayBuffer::NewBackingStore(this->isolate, this->chunkSize);
+                auto result = std::make_shared<ssize_t>(0);
+                int fd = this->fd;
+                off_t offset = this->offset;
+                bool seekable = this->seekable;
+
+                auto self = std::static_pointer_cast<ReadStream>(this->shared_from_this());
+                events::QueueWork(globals.globalLoop.get(), [fd, offset, seekable, store, result] {
+                    char *data = (char *) store->Data();
+                    size_t size = store->ByteLength();
+                    size_t filled = 0;
+
+                    // fill the whole chunk unless the file ends first
+                    while (filled < size) {
+                        ssize_t n = seekable ? pread(fd, data + filled, size - filled, offset + filled) : read(fd, data + filled, size - filled);
+                        if (n == -1 && errno == EINTR) {
+                            continue;
+                        }
+                        if (n == -1) {
+                            *result = filled > 0 ? (ssize_t) filled : -1;
+                            return;
+                        }
+                        if (n == 0) {
+                            break;
+                        }
+                        filled += n;
+                    }
+
+                    *result = (ssize_t) filled;
+                }, [self, store, result](v8::Local<v8::Context> ctx) {
+                    self->OnRead(ctx, store, *result);
+                });
+            }
+
+            void OnRead(v8::Local<v8::Context> ctx, std::shared_ptr<v8::BackingStore> store, ssize_t result) {
+                this->reading = false;
+
+                if (this->done) {
+                    // return() came in while the read was running
+                    this->Close();
+                    return;
+                }
+
+                if (result <= 0) {
+                    this->failed = result < 0;
+                    this->Finish(ctx);
+                    return;
+                }
+
+                this->offset += result;
+                this->ready = store;
+                this->readyLength = (size_t) result;
+
+                if (!this->waiting.empty()) {
+                    v8::Local<v8::Promise::Resolver> resolver = this->waiting.front().Get(this->isolate);
+                    this->waiting.pop_front();
+                    this->Deliver(ctx, resolver);
+                }
+            }
+
+            void Next(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) override {
+                if (this->ready) {
+                    this->Deliver(ctx, resolver);
+                } else if (this->done) {
+                    this->Settle(ctx, resolver);
+                } else {
+                    this->waiting.emplace_back(this->isolate, resolver);
+                    this->Prefetch();
+                }
+            }
+
+            void Return(v8::Local<v8::Context> ctx) override {
+                this->ready.reset();
+                this->Finish(ctx);
+            }
+
+        private:
+            // hands the waiting chunk over and starts on the next one
+            void Deliver(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(this->isolate, std::move(this->ready));
+                v8::Local<v8::Uint8Array> chunk = v8::Uint8Array::New(buffer, 0, this->readyLength);
+                this->ready.reset();
+
+                resolver->Resolve(ctx, iterResult(ctx, chunk, false)).Check();
+                this->Prefetch();
+            }
+
+            void Finish(v8::Local<v8::Context> ctx) {
+                this->done = true;
+                if (!this->reading) {
+                    this->Close();
+                }
+
+                while (!this->waiting.empty()) {
+                    v8::Local<v8::Promise::Resolver> resolver = this->waiting.front().Get(this->isolate);
+                    this->waiting.pop_front();
+                    this->Settle(ctx, resolver);
+                }
+            }
+
+            // end of the stream, or the read error once
+            void Settle(v8::Local<v8::Context> ctx, v8::Local<v8::Promise::Resolver> resolver) {
+                if (this->failed) {
+                    this->failed = false;
+                    v8::Local<v8::String> message = v8::String::NewFromUtf8(this->isolate, "Failed to read file").ToLocalChecked();
+                    resolver->Reject(ctx, v8::Exception::Error(message)).Check();
+                    return;
+                }
+
+                resolver->Resolve(ctx, iterResult(ctx, v8::Undefined(this->isolate), true)).Check();
+            }
+
+            void Close() {
+                if (this->fd != -1) {
+                    close(this->fd);
+                    this->fd = -1;
+                }
+            }
+
+            v8::Isolate *isolate;
+            int fd;
+            size_t chunkSize;
+            bool seekable;
+            off_t offset = 0;
+            bool reading = false;
+            bool done = false;
+            bool failed = false;
+            std::shared_ptr<v8::BackingStore> ready;
+            size_t readyLength = 0;
+            std::deque<v8::Global<v8::Promise::Resolver>> waiting;
+    };
+
+    void createReadStreamJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        size_t chunkSize = DEFAULT_CHUNK_SIZE;
+        if (args.Length() > 1 && args[1]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[1].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8(isolate, "chunkSize").ToLocalChecked()).ToLocal(&value)) {
+                return;
+            }
+
+            if (!value->IsUndefined()) {
+                double size = value->NumberValue(ctx).FromMaybe(0);
+                if (!(size >= 1 && size <= (double) MAX_CHUNK_SIZE)) {
+                    Senkora::throwException(ctx, "chunkSize must be between 1 byte and 1 GiB", Senkora::ExceptionType::RANGE);
+                    return;
+                }
+                chunkSize = (size_t) size;
+            }
+        }
+
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+        int fd = open(*pathUtf8, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            Senkora::throwException(ctx, "Failed to open file");
+            return;
+        }
+
+        struct stat s;
+        bool seekable = fstat(fd, &s) == 0 && S_ISREG(s.st_mode);
+
+        auto stream = std::make_shared<ReadStream>(isolate, fd, chunkSize, seekable);
+        v8::Local<v8::Object> object = newAsyncIterator(ctx, stream);
+
+        // the first chunk is on its way before anyone asks for it
+        stream->Prefetch();
+
+        args.GetReturnValue().Set(object);
+    }
+}
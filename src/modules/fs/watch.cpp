@@ -0,0 +1,340 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "watch.hpp"
+#include "direntries.hpp"
+#include "v8-context.h"
+#include "v8-exception.h"
+#include "v8-function.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-template.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace fsMod {
+    constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+        | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_EXCL_UNLINK;
+
+    // same names as node, renames cover creation and deletion too
+    static const char *RENAME_EVENT = "rename";
+    static const char *CHANGE_EVENT = "change";
+    // the kernel queue filled up and events were dropped, rescan
+    static const char *OVERFLOW_EVENT = "overflow";
+
+    typedef struct {
+        const char *type;
+        std::string path;
+    } WatchEvent;
+
+    // One inotify fd per watch() call. Recursive watches add a watch for
+    // every directory below the root, and for the ones created later.
+    class PathWatcher {
+        public:
+            PathWatcher(int fd, std::string root, bool recursive):
+                fd(fd), root(std::move(root)), recursive(recursive) {}
+
+            ~PathWatcher() {
+                close(this->fd);
+            }
+
+            // watches `relative` and, for recursive watches, what is below it
+            bool Add(const std::string& relative) {
+                std::vector<std::string> pending = { relative };
+
+                while (!pending.empty()) {
+                    std::string dir = std::move(pending.back());
+                    pending.pop_back();
+
+                    std::string path = this->Path(dir);
+                    int wd = inotify_add_watch(this->fd, path.c_str(), WATCH_MASK);
+                    if (wd == -1) {
+                        // gone again before we got to it, the parent reports that
+                        if (!dir.empty() && errno == ENOENT) {
+                            continue;
+                        }
+                        return false;
+                    }
+                    this->dirs[wd] = dir;
+
+                    if (!this->recursive) {
+                        continue;
+                    }
+
+                    int dirFd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                    if (dirFd == -1) {
+                        continue;
+                    }
+                    DirFd owner(dirFd);
+
+                    scanDirectory(dirFd, [&](const char *name, EntryType type) {
+                        if (type == DIRECTORY) {
+                            pending.push_back(dir.empty() ? name : dir + "/" + name);
+                        }
+                    });
+                }
+
+                return true;
+            }
+
+            // reads everything the kernel has queued, a path is reported
+            // once per type however many times it was touched meanwhile
+            void Drain(std::vector<WatchEvent>& events) {
+                alignas(struct inotify_event) char buffer[16 * 1024];
+                std::unordered_set<std::string> seen;
+
+                for (;;) {
+                    ssize_t n = read(this->fd, buffer, sizeof(buffer));
+                    if (n == -1 && errno == EINTR) {
+                        continue;
+                    }
+                    if (n <= 0) {
+                        return;
+                    }
+
+                    for (ssize_t offset = 0; offset < n;) {
+                        auto event = (struct inotify_event *) (buffer + offset);
+                        offset += sizeof(struct inotify_event) + event->len;
+
+                        if (event->mask & IN_Q_OVERFLOW) {
+                            push(events, seen, OVERFLOW_EVENT, "");
+                            continue;
+                        }
+
+                        auto it = this->dirs.find(event->wd);
+                        if (it == this->dirs.end()) {
+                            continue;
+                        }
+
+                        if (event->mask & IN_IGNORED) {
+                            this->dirs.erase(it);
+                            continue;
+                        }
+
+                        std::string path = it->second;
+                        if (event->len > 0 && event->name[0] != '\0') {
+                            path = path.empty() ? event->name : path + "/" + event->name;
+                        }
+                        if (path.empty()) {
+                            // the watched file or directory itself
+                            path = this->root.substr(this->root.rfind('/') + 1);
+                        }
+
+                        bool renamed = event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+                        push(events, seen, renamed ? RENAME_EVENT : CHANGE_EVENT, path);
+
+                        if (this->recursive && (event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                            this->Add(path);
+                        }
+                    }
+                }
+            }
+
+            const int fd;
+            events::EventLoop *loop = nullptr;
+            v8::Global<v8::Function> callback;
+            v8::Global<v8::Object> object;
+
+        private:
+            std::string Path(const std::string& relative) {
+                if (relative.empty()) {
+                    return this->root;
+                }
+                return this->root == "/" ? "/" + relative : this->root + "/" + relative;
+            }
+
+            static void push(std::vector<WatchEvent>& events, std::unordered_set<std::string>& seen, const char *type, const std::string& path) {
+                if (seen.insert(std::string(type) + '\0' + path).second) {
+                    events.push_back({ type, path });
+                }
+            }
+
+            const std::string root;
+            const bool recursive;
+            // watch descriptor -> directory relative to the root
+            std::unordered_map<int, std::string> dirs;
+    };
+
+    thread_local v8::Eternal<v8::ObjectTemplate> watcherTemplate;
+
+    static void onWatchEvents([[maybe_unused]] int fd, [[maybe_unused]] uint32_t events, void *data) {
+        PathWatcher *watcher = (PathWatcher *) data;
+
+        std::vector<WatchEvent> pending;
+        watcher->Drain(pending);
+        if (pending.empty()) {
+            return;
+        }
+
+        v8::Isolate *isolate = watcher->loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope handleScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        v8::Local<v8::String> typeKey = v8::String::NewFromUtf8Literal(isolate, "type", v8::NewStringType::kInternalized);
+        v8::Local<v8::String> pathKey = v8::String::NewFromUtf8Literal(isolate, "path", v8::NewStringType::kInternalized);
+
+        v8::Local<v8::Array> array = v8::Array::New(isolate, (int) pending.size());
+        for (size_t i = 0; i < pending.size(); i++) {
+            v8::Local<v8::Object> event = v8::Object::New(isolate);
+            event->Set(ctx, typeKey, v8::String::NewFromUtf8(isolate, pending[i].type, v8::NewStringType::kInternalized).ToLocalChecked()).Check();
+            event->Set(ctx, pathKey, v8::String::NewFromUtf8(isolate, pending[i].path.c_str(), v8::NewStringType::kNormal, (int) pending[i].path.size()).ToLocalChecked()).Check();
+            array->Set(ctx, (uint32_t) i, event).Check();
+        }
+
+        v8::TryCatch tryCatch(isolate);
+
+        // the callback may close the watcher, it isn't touched after this
+        v8::Local<v8::Value> argv[] = { array };
+        v8::MaybeLocal<v8::Value> result = watcher->callback.Get(isolate)->Call(ctx, watcher->object.Get(isolate), 1, argv);
+
+        if (tryCatch.HasTerminated()) {
+            return;
+        }
+
+        if (tryCatch.HasCaught() || result.IsEmpty()) {
+            Senkora::printException(ctx, tryCatch.Exception());
+        }
+    }
+
+    static PathWatcher *getWatcher(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        return (PathWatcher *) Senkora::getNativePointer(args.This(), Senkora::NativeType::PATH_WATCHER);
+    }
+
+    static void watcherClose(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        PathWatcher *watcher = getWatcher(args);
+        if (watcher == nullptr) {
+            return;
+        }
+
+        Senkora::setNativePointer(args.This(), Senkora::NativeType::PATH_WATCHER, nullptr);
+        events::Unwatch(watcher->loop, watcher->fd);
+        delete watcher;
+    }
+
+    // an unreferenced watcher doesn't keep the process running by itself
+    static void watcherRef(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        PathWatcher *watcher = getWatcher(args);
+        if (watcher != nullptr) {
+            events::SetRef(watcher->loop, watcher->fd, true);
+        }
+        args.GetReturnValue().Set(args.This());
+    }
+
+    static void watcherUnref(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        PathWatcher *watcher = getWatcher(args);
+        if (watcher != nullptr) {
+            events::SetRef(watcher->loop, watcher->fd, false);
+        }
+        args.GetReturnValue().Set(args.This());
+    }
+
+    void watchJS(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 2) {
+            Senkora::throwException(ctx, "Expected 2 arguments");
+            return;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        // the options can be left out
+        int callbackIndex = args[1]->IsFunction() ? 1 : 2;
+        if (!args[callbackIndex]->IsFunction()) {
+            Senkora::throwException(ctx, "Expected a callback function", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        bool recursive = false;
+        if (callbackIndex == 2 && args[1]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[1].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8Literal(isolate, "recursive")).ToLocal(&value)) {
+                return;
+            }
+            recursive = value->BooleanValue(isolate);
+        }
+
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+        std::string root = *pathUtf8;
+        while (root.size() > 1 && root.back() == '/') {
+            root.pop_back();
+        }
+
+        // recursing only makes sense below a directory
+        struct stat s;
+        if (stat(root.c_str(), &s) == -1) {
+            Senkora::throwException(ctx, "Failed to watch path");
+            return;
+        }
+        recursive = recursive && S_ISDIR(s.st_mode);
+
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd == -1) {
+            Senkora::throwException(ctx, "Failed to watch path");
+            return;
+        }
+
+        auto watcher = new PathWatcher(fd, root, recursive);
+        watcher->loop = globals.globalLoop.get();
+
+        if (!watcher->Add("") || !events::Watch(watcher->loop, fd, EPOLLIN, onWatchEvents, watcher)) {
+            delete watcher;
+            Senkora::throwException(ctx, "Failed to watch path");
+            return;
+        }
+
+        if (watcherTemplate.IsEmpty()) {
+            v8::Local<v8::ObjectTemplate> tmpl = v8::ObjectTemplate::New(isolate);
+            tmpl->SetInternalFieldCount(Senkora::NATIVE_FIELD_COUNT);
+            tmpl->Set(isolate, "close", v8::FunctionTemplate::New(isolate, watcherClose));
+            tmpl->Set(isolate, "ref", v8::FunctionTemplate::New(isolate, watcherRef));
+            tmpl->Set(isolate, "unref", v8::FunctionTemplate::New(isolate, watcherUnref));
+            watcherTemplate.Set(isolate, tmpl);
+        }
+
+        v8::Local<v8::Object> object = watcherTemplate.Get(isolate)->NewInstance(ctx).ToLocalChecked();
+        Senkora::setNativePointer(object, Senkora::NativeType::PATH_WATCHER, watcher);
+
+        // held strongly until close(), the loop may call back at any time
+        watcher->object.Reset(isolate, object);
+        watcher->callback.Reset(isolate, args[callbackIndex].As<v8::Function>());
+
+        args.GetReturnValue().Set(object);
+    }
+}
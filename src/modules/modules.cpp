@@ -18,6 +18,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "modules.hpp"
 #include "empty.hpp"
 #include "fs/mod.hpp"
+#include "fs/promises.hpp"
 #include "toml/mod.hpp"
 #include "test/mod.hpp"
 #include "../../config.h"
@@ -40,7 +41,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 namespace fs = std::filesystem;
 
-extern const Senkora::SharedGlobals globals;
+extern thread_local const Senkora::SharedGlobals globals;
 
 namespace Senkora::Modules {
     void metadataHook(v8::Local<v8::Context> ctx, v8::Local<v8::Module> mod, v8::Local<v8::Object> meta) {
@@ -70,7 +71,8 @@ namespace Senkora::Modules {
 
         if (!base.compare(0, 8, "senkora:"))
         {
-            if (!globals.moduleCache.contains(base)) {
+            v8::Local<v8::Module> mod;
+            if (!builtinModule(ctx, base).ToLocal(&mod)) {
                 std::string msg = "Module \"";
                 msg += base.c_str();
                 msg += "\" was not found!";
@@ -78,7 +80,7 @@ namespace Senkora::Modules {
                 exit(1);
             }
 
-            return globals.moduleCache[base];
+            return mod;
         }
 
         if (base.c_str()[0] != '/')
@@ -158,33 +160,47 @@ namespace Senkora::Modules {
         }
     }
 
-    // INIT builtin modules here
-    void initBuiltinModules(v8::Isolate *isolate) {
-        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
-
-        globals.moduleCache["senkora:__empty"] = createModule(ctx, 
-            "senkora:__empty",
-            dummy::getExports(isolate), dummy::init).ToLocalChecked();
+    typedef struct {
+        const char *name;
+        std::vector<v8::Local<v8::String>> (*getExports)(v8::Isolate *isolate);
+        v8::Module::SyntheticModuleEvaluationSteps init;
+    } BuiltinModule;
 
+    // INIT builtin modules here
+    static const BuiltinModule builtinModules[] = {
+        { "senkora:__empty", dummy::getExports, dummy::init },
         #ifdef ENABLE_FS
-        globals.moduleCache["senkora:fs"] = createModule(ctx, 
-            "senkora:fs",
-            fsMod::getExports(isolate), fsMod::init).ToLocalChecked();
-        globals.moduleExports["senkora:fs"] = fsMod::getExports(isolate);
+        { "senkora:fs", fsMod::getExports, fsMod::init },
+        { "senkora:fs/promises", fsPromisesMod::getExports, fsPromisesMod::init },
         #endif
-
         #ifdef ENABLE_TOML
-        globals.moduleCache["senkora:toml"] = createModule(ctx,
-            "senkora:toml",
-            tomlMod::getExports(isolate), tomlMod::init).ToLocalChecked();
-        globals.moduleExports["senkora:toml"] = tomlMod::getExports(isolate);
+        { "senkora:toml", tomlMod::getExports, tomlMod::init },
         #endif
-
         #ifdef ENABLE_TEST
-        globals.moduleCache["senkora:test"] = createModule(ctx,
-            "senkora:test",
-            testMod::getExports(isolate), testMod::init).ToLocalChecked();
-        globals.moduleExports["senkora:test"] = testMod::getExports(isolate);
+        { "senkora:test", testMod::getExports, testMod::init },
         #endif
+    };
+
+    // synthetic modules can't go in the startup snapshot, so each one is
+    // only created the first time something imports it
+    v8::MaybeLocal<v8::Module> builtinModule(v8::Local<v8::Context> ctx, const std::string& name) {
+        for (const BuiltinModule& builtin : builtinModules) {
+            if (name != builtin.name) {
+                continue;
+            }
+
+            // keyed by the static name, `name` doesn't outlive the import
+            if (!globals.moduleCache.contains(builtin.name)) {
+                v8::Isolate *isolate = ctx->GetIsolate();
+                globals.moduleCache[builtin.name] = createModule(ctx,
+                    builtin.name,
+                    builtin.getExports(isolate), builtin.init).ToLocalChecked();
+                globals.moduleExports[builtin.name] = builtin.getExports(isolate);
+            }
+
+            return globals.moduleCache[builtin.name];
+        }
+
+        return v8::MaybeLocal<v8::Module>();
     }
 }
@@ -60,7 +60,9 @@ namespace Senkora::Modules {
         v8::Local<v8::Value> export_value
     );
 
-    void initBuiltinModules(v8::Isolate *isolate);
+    // the builtin module `name` (senkora:fs, ...), created on first use,
+    // empty when there is no such module
+    v8::MaybeLocal<v8::Module> builtinModule(v8::Local<v8::Context> ctx, const std::string& name);
 }
 
 #endif
@@ -25,7 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "matchers.hpp"
 #include "constants.hpp"
 
-extern const Senkora::SharedGlobals globals;
+extern thread_local const Senkora::SharedGlobals globals;
 
 namespace testMatcher
 {
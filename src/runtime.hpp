@@ -0,0 +1,43 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef RUNTIME_HPP
+#define RUNTIME_HPP
+
+#include <v8.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bootstrapping shared by the main thread and workers, implemented in main.cpp
+namespace runtime {
+    // every isolate shares one allocator so buffers can move between them
+    v8::Isolate *NewIsolate();
+    // a context with the Senkora globals and builtin modules set up, the
+    // worker scope globals (postMessage, onmessage, close) are only added
+    // for workers
+    v8::Local<v8::Context> CreateContext(v8::Isolate *isolate, bool worker = false);
+    // the globals of a new context without any isolate or loop state, this
+    // is what the startup snapshot stores
+    v8::Local<v8::Context> BuildContext(v8::Isolate *isolate, bool worker);
+    // every native callback BuildContext hands to V8
+    void ExternalReferences(std::vector<intptr_t>& refs);
+    // false once the error has been printed
+    bool RunModule(v8::Local<v8::Context> ctx, const std::string& filePath);
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "scheduler.hpp"
+#include "eventLoop.hpp"
+#include "v8-context.h"
+#include "v8-exception.h"
+#include "v8-function.h"
+#include "v8-local-handle.h"
+#include "v8-primitive.h"
+#include "v8-promise.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+#include <string.h>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace events {
+    // tasks stop for the tick once this much time went by, the rest wait
+    // behind timers and I/O so a backlog can't starve them
+    constexpr uint64_t TASK_BUDGET_NS = 5 * 1000 * 1000;
+
+    void TaskQueue::Push(TaskPriority priority, Task task) {
+        this->tasks[(int) priority].push_back(std::move(task));
+        this->size++;
+    }
+
+    void TaskQueue::PushContinuation(TaskPriority priority, Task task) {
+        this->continuations[(int) priority].push_back(std::move(task));
+        this->size++;
+    }
+
+    bool TaskQueue::Pop(Task& task, TaskPriority& priority) {
+        for (int i = 0; i < TASK_PRIORITIES; i++) {
+            std::deque<Task> *queue = !this->continuations[i].empty() ? &this->continuations[i] : &this->tasks[i];
+            if (queue->empty()) {
+                continue;
+            }
+
+            task = std::move(queue->front());
+            queue->pop_front();
+            priority = (TaskPriority) i;
+            this->size--;
+            return true;
+        }
+
+        return false;
+    }
+
+    // Runs at most the tasks that were queued when the tick got here, for
+    // no longer than the budget, with a microtask checkpoint after each.
+    void RunTasks(EventLoop* const& loop) {
+        if (loop->tasks.Empty()) {
+            return;
+        }
+
+        v8::Isolate *isolate = loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope scope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        uint64_t deadline = getTimeInNs() + TASK_BUDGET_NS;
+        size_t count = loop->tasks.Size();
+
+        Task task;
+        TaskPriority priority;
+        while (count-- > 0 && loop->tasks.Pop(task, priority)) {
+            v8::HandleScope taskScope(isolate);
+            v8::Local<v8::Promise::Resolver> resolver = task.resolver.Get(isolate);
+
+            // the task goes on in the microtasks of the checkpoint, a yield()
+            // from there has to come back at its priority as well
+            loop->tasks.current = priority;
+
+            if (task.callback.IsEmpty()) {
+                resolver->Resolve(ctx, v8::Undefined(isolate)).Check();
+            } else {
+                v8::TryCatch tryCatch(isolate);
+                v8::MaybeLocal<v8::Value> result = task.callback.Get(isolate)->Call(ctx, v8::Undefined(isolate), 0, nullptr);
+                if (tryCatch.HasTerminated()) {
+                    loop->tasks.current = TaskPriority::USER_VISIBLE;
+                    return;
+                }
+
+                v8::Local<v8::Value> value;
+                if (result.ToLocal(&value)) {
+                    resolver->Resolve(ctx, value).Check();
+                } else {
+                    resolver->Reject(ctx, tryCatch.Exception()).Check();
+                }
+            }
+
+            task.callback.Reset();
+            task.resolver.Reset();
+            Checkpoint(loop);
+
+            loop->tasks.current = TaskPriority::USER_VISIBLE;
+
+            if (getTimeInNs() >= deadline) {
+                break;
+            }
+        }
+    }
+
+    static bool parsePriority(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, TaskPriority& priority) {
+        v8::String::Utf8Value name(ctx->GetIsolate(), value);
+        if (*name == nullptr) {
+            return false;
+        }
+
+        if (strcmp(*name, "user-blocking") == 0) {
+            priority = TaskPriority::USER_BLOCKING;
+        } else if (strcmp(*name, "user-visible") == 0) {
+            priority = TaskPriority::USER_VISIBLE;
+        } else if (strcmp(*name, "background") == 0) {
+            priority = TaskPriority::BACKGROUND;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    void postTask(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected at least 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsFunction()) {
+            Senkora::throwException(ctx, "postTask requires a function as the first argument", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        TaskPriority priority = TaskPriority::USER_VISIBLE;
+        if (args.Length() > 1 && args[1]->IsObject()) {
+            v8::Local<v8::Value> value;
+            if (!args[1].As<v8::Object>()->Get(ctx, v8::String::NewFromUtf8(isolate, "priority").ToLocalChecked()).ToLocal(&value)) {
+                return;
+            }
+
+            if (!value->IsUndefined() && !parsePriority(ctx, value, priority)) {
+                Senkora::throwException(ctx, "priority must be one of 'user-blocking', 'user-visible' or 'background'", Senkora::ExceptionType::TYPE);
+                return;
+            }
+        }
+
+        v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(ctx).ToLocalChecked();
+
+        Task task;
+        task.callback.Reset(isolate, args[0].As<v8::Function>());
+        task.resolver.Reset(isolate, resolver);
+        globals.globalLoop->tasks.Push(priority, std::move(task));
+
+        args.GetReturnValue().Set(resolver->GetPromise());
+    }
+
+    // continues at the priority of the calling task, ahead of its queue
+    void yield(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        EventLoop *loop = globals.globalLoop.get();
+        v8::Local<v8::Promise::Resolver> resolver = v8::Promise::Resolver::New(ctx).ToLocalChecked();
+
+        Task task;
+        task.resolver.Reset(isolate, resolver);
+        loop->tasks.PushContinuation(loop->tasks.current, std::move(task));
+
+        args.GetReturnValue().Set(resolver->GetPromise());
+    }
+}
@@ -0,0 +1,65 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "v8-function.h"
+#include "v8-persistent-handle.h"
+#include "v8-promise.h"
+#include <v8.h>
+
+#include <deque>
+
+namespace events {
+    enum class TaskPriority {
+        USER_BLOCKING = 0,
+        USER_VISIBLE,
+        BACKGROUND
+    };
+
+    constexpr int TASK_PRIORITIES = 3;
+
+    // a scheduler.yield() continuation has no callback, it only resolves
+    typedef struct {
+        v8::Global<v8::Function> callback;
+        v8::Global<v8::Promise::Resolver> resolver;
+    } Task;
+
+    // One FIFO per priority, with yield() continuations ahead of
+    // the tasks of their priority.
+    class TaskQueue {
+        public:
+            void Push(TaskPriority priority, Task task);
+            void PushContinuation(TaskPriority priority, Task task);
+            // highest priority first, false when empty
+            bool Pop(Task& task, TaskPriority& priority);
+
+            bool Empty() const { return this->size == 0; }
+            size_t Size() const { return this->size; }
+
+            // priority of the task running right now, yield() continues at it
+            TaskPriority current = TaskPriority::USER_VISIBLE;
+
+        private:
+            std::deque<Task> tasks[TASK_PRIORITIES];
+            std::deque<Task> continuations[TASK_PRIORITIES];
+            size_t size = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,188 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "snapshot.hpp"
+#include "runtime.hpp"
+#include "v8-snapshot.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace snapshot {
+    // the blob is stored after this, V8 only checks its own version so the
+    // header ties a blob to the build that made it
+    typedef struct {
+        char magic[8];
+        uint64_t layout;
+    } Header;
+
+    static const char MAGIC[8] = { 'S', 'E', 'N', 'K', 'S', 'N', 'A', 'P' };
+
+    const intptr_t *ExternalReferences() {
+        static const std::vector<intptr_t> refs = [] {
+            std::vector<intptr_t> refs;
+            runtime::ExternalReferences(refs);
+            refs.push_back(0);
+            return refs;
+        }();
+
+        return refs.data();
+    }
+
+    // the blob stores indexes into the reference table, a blob of another
+    // build would call the wrong functions. The distances between the
+    // callbacks survive ASLR and change with the table or the code around it
+    static uint64_t layout() {
+        const intptr_t *refs = ExternalReferences();
+
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](uint64_t value) {
+            for (int i = 0; i < 8; i++) {
+                hash ^= (value >> (i * 8)) & 0xff;
+                hash *= 1099511628211ull;
+            }
+        };
+
+        for (size_t i = 1; refs[i] != 0; i++) {
+            mix(refs[i] - refs[0]);
+        }
+        for (const char *c = v8::V8::GetVersion(); *c; c++) {
+            mix(*c);
+        }
+
+        return hash;
+    }
+
+    std::string Path() {
+        if (const char *path = getenv("SENKORA_SNAPSHOT"); path != nullptr && std::string(path) != "0") {
+            return path;
+        }
+
+        std::error_code err;
+        fs::path exe = fs::read_symlink("/proc/self/exe", err);
+        if (err) {
+            return std::string();
+        }
+
+        return (exe.parent_path() / "senkora.snapshot").string();
+    }
+
+    v8::StartupData *Load() {
+        // every isolate of the process boots from the same blob, it stays
+        // mapped until exit
+        static v8::StartupData *blob = [] () -> v8::StartupData * {
+            const char *enabled = getenv("SENKORA_SNAPSHOT");
+            if (enabled != nullptr && std::string(enabled) == "0") {
+                return nullptr;
+            }
+
+            std::string path = Path();
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return nullptr;
+            }
+
+            struct stat st;
+            if (fstat(fd, &st) < 0 || st.st_size <= (off_t) sizeof(Header) || st.st_size > INT32_MAX) {
+                close(fd);
+                return nullptr;
+            }
+
+            size_t size = st.st_size;
+            void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED) {
+                return nullptr;
+            }
+
+            const Header *header = (const Header *) data;
+            if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || header->layout != layout()) {
+                munmap(data, size);
+                return nullptr;
+            }
+
+            static v8::StartupData startup;
+            startup.data = (const char *) data + sizeof(Header);
+            startup.raw_size = (int) (size - sizeof(Header));
+            if (!startup.IsValid()) {
+                munmap(data, size);
+                return nullptr;
+            }
+
+            return &startup;
+        }();
+
+        return blob;
+    }
+
+    bool Create(const std::string& path) {
+        v8::StartupData blob;
+        {
+            v8::SnapshotCreator creator(ExternalReferences());
+            v8::Isolate *isolate = creator.GetIsolate();
+            {
+                v8::HandleScope handle_scope(isolate);
+
+                // what a plain v8::Context::New gets, Senkora never boots it
+                creator.SetDefaultContext(v8::Context::New(isolate));
+
+                // added in ContextIndex order
+                creator.AddContext(runtime::BuildContext(isolate, false));
+                creator.AddContext(runtime::BuildContext(isolate, true));
+            }
+
+            blob = creator.CreateBlob(v8::SnapshotCreator::FunctionCodeHandling::kClear);
+        }
+
+        if (blob.data == nullptr) {
+            return false;
+        }
+
+        Header header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.layout = layout();
+
+        // a running Senkora may have the old blob mapped, never write into it
+        std::string temp = path + "." + std::to_string(getpid()) + ".tmp";
+        bool written;
+        {
+            std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+            file.write((const char *) &header, sizeof(header));
+            file.write(blob.data, blob.raw_size);
+            written = file.good();
+        }
+        delete[] blob.data;
+
+        if (!written || rename(temp.c_str(), path.c_str()) < 0) {
+            unlink(temp.c_str());
+            return false;
+        }
+
+        return true;
+    }
+}
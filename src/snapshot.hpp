@@ -0,0 +1,51 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <v8.h>
+#include <cstdint>
+#include <string>
+
+// V8 startup snapshot of the initialized main and worker contexts, so a new
+// isolate deserializes its globals instead of building every template again.
+// `senkora snapshot` writes it next to the executable (the build runs it),
+// $SENKORA_SNAPSHOT points somewhere else and SENKORA_SNAPSHOT=0 turns it off.
+namespace snapshot {
+    // contexts stored in the blob, in the order they are added
+    enum ContextIndex : size_t {
+        MAIN_CONTEXT = 0,
+        WORKER_CONTEXT = 1
+    };
+
+    // null terminated, the same table creates and loads a blob
+    const intptr_t *ExternalReferences();
+
+    // the blob for this build, nullptr when there is none, it is made by
+    // another build of Senkora or V8 refuses it
+    v8::StartupData *Load();
+
+    // writes a new blob to `path`, false when it could not be written
+    bool Create(const std::string& path);
+
+    // where Load looks for the blob, $SENKORA_SNAPSHOT or senkora.snapshot
+    // in the directory of the executable
+    std::string Path();
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+
+namespace events {
+    ThreadPool::ThreadPool(size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            this->threads.emplace_back(&ThreadPool::Worker, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->cond.notify_all();
+
+        for (auto& thread : this->threads) {
+            thread.join();
+        }
+    }
+
+    void ThreadPool::Submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->queue.push_back(std::move(task));
+        }
+        this->cond.notify_one();
+    }
+
+    void ThreadPool::Worker() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->cond.wait(lock, [this] { return this->stopping || !this->queue.empty(); });
+
+                if (this->queue.empty()) {
+                    return;
+                }
+
+                task = std::move(this->queue.front());
+                this->queue.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    ThreadPool& GetThreadPool() {
+        static ThreadPool pool([] {
+            size_t size = 4;
+            if (const char *env = getenv("SENKORA_THREADPOOL_SIZE")) {
+                long value = strtol(env, nullptr, 10);
+                if (value > 0 && value <= 1024) {
+                    size = (size_t) value;
+                }
+            }
+
+            return size;
+        }());
+
+        return pool;
+    }
+
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t)>& body) {
+        if (grain == 0) {
+            grain = 1;
+        }
+
+        struct State {
+            std::atomic<size_t> next{0};
+            size_t done = 0;
+            std::mutex mutex;
+            std::condition_variable cond;
+        };
+        auto state = std::make_shared<State>();
+
+        // helpers that start after everything is claimed never call `body`,
+        // so they can outlive this call without touching the caller's data
+        auto run = [state, count, grain, &body] {
+            for (;;) {
+                size_t begin = state->next.fetch_add(grain);
+                if (begin >= count) {
+                    return;
+                }
+
+                size_t end = begin + grain < count ? begin + grain : count;
+                for (size_t i = begin; i < end; i++) {
+                    body(i);
+                }
+
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->done += end - begin;
+                if (state->done == count) {
+                    state->cond.notify_all();
+                }
+            }
+        };
+
+        // the caller takes one chunk itself
+        size_t chunks = (count + grain - 1) / grain;
+        size_t helpers = std::min(GetThreadPool().Size(), chunks > 0 ? chunks - 1 : 0);
+        for (size_t i = 0; i < helpers; i++) {
+            GetThreadPool().Submit(run);
+        }
+
+        run();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->cond.wait(lock, [&] { return state->done == count; });
+    }
+}
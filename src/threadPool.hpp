@@ -0,0 +1,64 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef THREADPOOL
+#define THREADPOOL
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace events {
+
+    // Fixed set of worker threads for blocking native work.
+    // Tasks never touch V8, results are handed back through the event loop.
+    class ThreadPool {
+        public:
+            explicit ThreadPool(size_t size);
+            ~ThreadPool();
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            void Submit(std::function<void()> task);
+            size_t Size() const { return this->threads.size(); }
+
+        private:
+            void Worker();
+
+            std::vector<std::thread> threads;
+            std::deque<std::function<void()>> queue;
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool stopping = false;
+    };
+
+    // Process wide pool, started on first use. SENKORA_THREADPOOL_SIZE
+    // overrides the default of 4 threads.
+    ThreadPool& GetThreadPool();
+
+    // Calls `body(i)` for every i below `count`, `grain` indices at a time,
+    // on the calling thread and as many pool threads as there are chunks to
+    // share. Returns once all of them are done. The caller takes part, so
+    // this is safe to call from a pool thread too.
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t)>& body);
+}
+
+#endif
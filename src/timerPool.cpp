@@ -0,0 +1,79 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "eventLoop.hpp"
+
+namespace events {
+    EventLoopData *TimerPool::Acquire() {
+        uint32_t index;
+
+        if (!this->freeList.empty()) {
+            index = this->freeList.back();
+            this->freeList.pop_back();
+        } else {
+            if (this->allocated == ((uint32_t) 1 << INDEX_BITS)) {
+                return nullptr;
+            }
+
+            if ((this->allocated & (CHUNK_SIZE - 1)) == 0) {
+                this->chunks.push_back(std::make_unique<EventLoopData[]>(CHUNK_SIZE));
+            }
+
+            index = this->allocated++;
+            EventLoopData *data = this->At(index);
+            data->index = index;
+            data->generation = 1;
+        }
+
+        EventLoopData *data = this->At(index);
+        data->id = ((uint64_t) data->generation << INDEX_BITS) | index;
+        data->node.id = data->id;
+        this->live++;
+
+        return data;
+    }
+
+    EventLoopData *TimerPool::Get(uint64_t id) {
+        uint32_t index = (uint32_t) (id & (((uint64_t) 1 << INDEX_BITS) - 1));
+        if (index >= this->allocated) {
+            return nullptr;
+        }
+
+        // generations start at 1, so a released slot's id of 0 never matches
+        EventLoopData *data = this->At(index);
+        if (id == 0 || data->id != id) {
+            return nullptr;
+        }
+
+        return data;
+    }
+
+    void TimerPool::Release(EventLoopData *data) {
+        data->callback.Reset();
+        data->global.Reset();
+        data->id = 0;
+        data->node.id = 0;
+        data->generation = data->generation == MAX_GENERATION ? 1 : data->generation + 1;
+
+        this->freeList.push_back(data->index);
+        this->live--;
+    }
+
+    EventLoopData *TimerPool::At(uint32_t index) {
+        return &this->chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+    }
+}
@@ -0,0 +1,214 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "timerWheel.hpp"
+
+#include <cstring>
+
+namespace events {
+    TimerWheel::TimerWheel(uint64_t now): current(now), count(0) {
+        for (int level = 0; level < LEVELS; level++) {
+            for (size_t slot = 0; slot < SLOTS; slot++) {
+                this->slots[level][slot].prev = &this->slots[level][slot];
+                this->slots[level][slot].next = &this->slots[level][slot];
+            }
+        }
+        memset(this->occupied, 0, sizeof(this->occupied));
+    }
+
+    void TimerWheel::Insert(TimerNode *node, uint64_t expires) {
+        if (node->next != nullptr) {
+            this->Remove(node);
+        }
+
+        node->expires = expires;
+        this->Link(node);
+        this->count++;
+    }
+
+    void TimerWheel::Remove(TimerNode *node) {
+        if (node->next == nullptr) {
+            return;
+        }
+
+        this->Unlink(node);
+        this->count--;
+    }
+
+    void TimerWheel::Advance(uint64_t now, std::vector<uint64_t>& expired) {
+        while (this->current <= now) {
+            if (this->count == 0) {
+                this->current = now + 1;
+                break;
+            }
+
+            size_t index = this->current & SLOT_MASK;
+
+            // every level cascades when all the levels below it wrap around
+            if (index == 0) {
+                for (int level = 1; level < LEVELS; level++) {
+                    size_t levelIndex = (this->current >> (level * SLOT_BITS)) & SLOT_MASK;
+                    this->Cascade(level, levelIndex);
+                    if (levelIndex != 0) {
+                        break;
+                    }
+                }
+            }
+
+            TimerNode *head = &this->slots[0][index];
+            while (head->next != head) {
+                TimerNode *node = head->next;
+                this->Unlink(node);
+                this->count--;
+                expired.push_back(node->id);
+            }
+
+            this->current++;
+
+            // nothing left on the lowest level, jump to the next cascade
+            if (this->LevelEmpty(0)) {
+                uint64_t boundary = (this->current + SLOT_MASK) & ~SLOT_MASK;
+                this->current = boundary < now + 1 ? boundary : now + 1;
+            }
+        }
+    }
+
+    uint64_t TimerWheel::NextExpiry() const {
+        if (this->count == 0) {
+            return UINT64_MAX;
+        }
+
+        uint64_t next = UINT64_MAX;
+
+        int offset = this->FindNext(0, this->current & SLOT_MASK);
+        if (offset != -1) {
+            next = this->current + offset;
+        }
+
+        // higher levels only tell when their slot cascades, which is
+        // never later than the expiry of the timers in it
+        for (int level = 1; level < LEVELS; level++) {
+            uint64_t unit = (uint64_t) 1 << (level * SLOT_BITS);
+            uint64_t base = (this->current + unit - 1) & ~(unit - 1);
+
+            offset = this->FindNext(level, (base >> (level * SLOT_BITS)) & SLOT_MASK);
+            if (offset != -1 && base + offset * unit < next) {
+                next = base + offset * unit;
+            }
+        }
+
+        return next;
+    }
+
+    void TimerWheel::Link(TimerNode *node) {
+        uint64_t expires = node->expires;
+        int level;
+        size_t slot;
+
+        if (expires < this->current) {
+            level = 0;
+            slot = this->current & SLOT_MASK;
+        } else {
+            uint64_t delta = expires - this->current;
+
+            if (delta > UINT32_MAX) {
+                delta = UINT32_MAX;
+                expires = this->current + delta;
+            }
+
+            level = 0;
+            while (level < LEVELS - 1 && delta >= ((uint64_t) 1 << ((level + 1) * SLOT_BITS))) {
+                level++;
+            }
+            slot = (expires >> (level * SLOT_BITS)) & SLOT_MASK;
+        }
+
+        TimerNode *head = &this->slots[level][slot];
+        node->level = (uint8_t) level;
+        node->slot = (uint8_t) slot;
+        node->prev = head->prev;
+        node->next = head;
+        head->prev->next = node;
+        head->prev = node;
+
+        this->occupied[level][slot / 64] |= (uint64_t) 1 << (slot % 64);
+    }
+
+    void TimerWheel::Unlink(TimerNode *node) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        node->prev = nullptr;
+        node->next = nullptr;
+
+        TimerNode *head = &this->slots[node->level][node->slot];
+        if (head->next == head) {
+            this->occupied[node->level][node->slot / 64] &= ~((uint64_t) 1 << (node->slot % 64));
+        }
+    }
+
+    void TimerWheel::Cascade(int level, size_t index) {
+        TimerNode *head = &this->slots[level][index];
+        if (head->next == head) {
+            return;
+        }
+
+        // detach the whole slot first, relinking may land in the same one
+        TimerNode *first = head->next;
+        TimerNode *last = head->prev;
+        head->next = head;
+        head->prev = head;
+        this->occupied[level][index / 64] &= ~((uint64_t) 1 << (index % 64));
+        last->next = nullptr;
+
+        while (first != nullptr) {
+            TimerNode *next = first->next;
+            this->Link(first);
+            first = next;
+        }
+    }
+
+    bool TimerWheel::LevelEmpty(int level) const {
+        for (size_t word = 0; word < WORDS; word++) {
+            if (this->occupied[level][word]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // offset from `start` of the first occupied slot, wrapping around
+    int TimerWheel::FindNext(int level, size_t start) const {
+        for (size_t step = 0; step <= WORDS; step++) {
+            size_t word = (start / 64 + step) % WORDS;
+            uint64_t bits = this->occupied[level][word];
+
+            if (step == 0) {
+                bits &= ~(uint64_t) 0 << (start % 64);
+            } else if (step == WORDS) {
+                bits &= ((uint64_t) 1 << (start % 64)) - 1;
+            }
+
+            if (bits) {
+                size_t slot = word * 64 + __builtin_ctzll(bits);
+                return (int) ((slot - start) & SLOT_MASK);
+            }
+        }
+
+        return -1;
+    }
+}
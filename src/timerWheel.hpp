@@ -0,0 +1,78 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef TIMERWHEEL
+#define TIMERWHEEL
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace events {
+
+    // Intrusive list node, embedded in whatever owns the timer.
+    // `next == nullptr` means the node is not scheduled.
+    typedef struct TimerNode {
+        TimerNode *prev = nullptr;
+        TimerNode *next = nullptr;
+        uint64_t expires = 0;
+        uint64_t id = 0;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+    } TimerNode;
+
+    // Hierarchical timing wheel with 1ms resolution.
+    // Four levels of 256 slots cover ~49 days; later deadlines are parked
+    // in the last level and re-cascaded until they come into range.
+    class TimerWheel {
+        public:
+            explicit TimerWheel(uint64_t now);
+            TimerWheel(const TimerWheel&) = delete;
+            TimerWheel& operator=(const TimerWheel&) = delete;
+
+            void Insert(TimerNode *node, uint64_t expires);
+            void Remove(TimerNode *node);
+            // appends the ids of every timer due at or before `now` to `expired`
+            void Advance(uint64_t now, std::vector<uint64_t>& expired);
+            // a lower bound of the next expiry, UINT64_MAX when empty
+            uint64_t NextExpiry() const;
+
+            bool Empty() const { return this->count == 0; }
+            size_t Size() const { return this->count; }
+
+        private:
+            static constexpr int LEVELS = 4;
+            static constexpr int SLOT_BITS = 8;
+            static constexpr size_t SLOTS = 1 << SLOT_BITS;
+            static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+            static constexpr size_t WORDS = SLOTS / 64;
+
+            void Link(TimerNode *node);
+            void Unlink(TimerNode *node);
+            void Cascade(int level, size_t index);
+            bool LevelEmpty(int level) const;
+            int FindNext(int level, size_t start) const;
+
+            TimerNode slots[LEVELS][SLOTS];
+            uint64_t occupied[LEVELS][WORDS];
+            // the next millisecond to be processed
+            uint64_t current;
+            size_t count;
+    };
+}
+
+#endif
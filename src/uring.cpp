@@ -0,0 +1,166 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "uring.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace events {
+    std::unique_ptr<Uring> Uring::Create(unsigned entries) {
+        if (getenv("SENKORA_DISABLE_IO_URING") != nullptr) {
+            return nullptr;
+        }
+
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        std::unique_ptr<Uring> ring(new Uring());
+        ring->fd = fd;
+        ring->entries = params.sq_entries;
+
+        ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+        }
+
+        ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ring->sqRing == MAP_FAILED) {
+            ring->sqRing = nullptr;
+            return nullptr;
+        }
+
+        if (singleMmap) {
+            ring->cqRing = ring->sqRing;
+        } else {
+            ring->cqRing = mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (ring->cqRing == MAP_FAILED) {
+                ring->cqRing = nullptr;
+                return nullptr;
+            }
+        }
+
+        ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->sqes = (io_uring_sqe *) sqes;
+
+        auto sq = (char *) ring->sqRing;
+        ring->sqHead = (unsigned *) (sq + params.sq_off.head);
+        ring->sqTail = (unsigned *) (sq + params.sq_off.tail);
+        ring->sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+        ring->sqArray = (unsigned *) (sq + params.sq_off.array);
+        ring->sqLocalTail = *ring->sqTail;
+
+        auto cq = (char *) ring->cqRing;
+        ring->cqHead = (unsigned *) (cq + params.cq_off.head);
+        ring->cqTail = (unsigned *) (cq + params.cq_off.tail);
+        ring->cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+        ring->cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+
+        // without a probe (pre 5.6 kernels) none of the file ops exist anyway
+        size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        auto probe = (io_uring_probe *) calloc(1, probeSize);
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+            for (unsigned i = 0; i < probe->ops_len && i < 256; i++) {
+                ring->supported[i] = probe->ops[i].flags & IO_URING_OP_SUPPORTED;
+            }
+        }
+        free(probe);
+
+        return ring;
+    }
+
+    Uring::~Uring() {
+        if (this->sqes != nullptr) {
+            munmap(this->sqes, this->sqesSize);
+        }
+        if (this->cqRing != nullptr && this->cqRing != this->sqRing) {
+            munmap(this->cqRing, this->cqRingSize);
+        }
+        if (this->sqRing != nullptr) {
+            munmap(this->sqRing, this->sqRingSize);
+        }
+        if (this->fd != -1) {
+            close(this->fd);
+        }
+    }
+
+    bool Uring::Supports(uint8_t opcode) const {
+        return this->supported[opcode];
+    }
+
+    // every request keeps at most one sqe in flight, so capping requests at
+    // the ring size means neither the sq nor the cq can overflow
+    bool Uring::Reserve() {
+        if (this->active >= this->entries) {
+            return false;
+        }
+
+        this->active++;
+        return true;
+    }
+
+    void Uring::Release() {
+        this->active--;
+    }
+
+    io_uring_sqe *Uring::GetSqe(UringRequest *request) {
+        unsigned head = __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE);
+        if (this->sqLocalTail - head >= this->entries) {
+            this->Submit();
+            head = __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE);
+            if (this->sqLocalTail - head >= this->entries) {
+                return nullptr;
+            }
+        }
+
+        unsigned index = this->sqLocalTail & *this->sqMask;
+        io_uring_sqe *sqe = &this->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = (uint64_t) (uintptr_t) request;
+
+        this->sqArray[index] = index;
+        this->sqLocalTail++;
+
+        return sqe;
+    }
+
+    void Uring::Submit() {
+        unsigned pending = this->sqLocalTail - __atomic_load_n(this->sqHead, __ATOMIC_ACQUIRE);
+        if (pending == 0) {
+            return;
+        }
+
+        __atomic_store_n(this->sqTail, this->sqLocalTail, __ATOMIC_RELEASE);
+
+        // whatever isn't consumed now stays in the ring for the next call
+        syscall(__NR_io_uring_enter, this->fd, pending, 0, 0, nullptr, 0);
+    }
+}
@@ -0,0 +1,111 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef URING
+#define URING
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <linux/io_uring.h>
+#include <v8.h>
+
+namespace events {
+
+    // An operation made of one or more io_uring submissions in a row.
+    // Only one of its sqes is in flight at any time.
+    class UringRequest {
+        public:
+            virtual ~UringRequest() = default;
+            // called on the loop thread with the result of the last sqe,
+            // returns false once the request is done and can be deleted
+            virtual bool Complete(v8::Local<v8::Context> ctx, int res) = 0;
+    };
+
+    // Minimal io_uring on top of the raw syscalls, so there is no liburing
+    // dependency. Not thread safe, each event loop owns its own ring.
+    class Uring {
+        public:
+            // nullptr when the kernel (or a seccomp filter) doesn't allow io_uring
+            static std::unique_ptr<Uring> Create(unsigned entries);
+            ~Uring();
+            Uring(const Uring&) = delete;
+            Uring& operator=(const Uring&) = delete;
+
+            bool Supports(uint8_t opcode) const;
+            // claims room for one more request, false when the ring is saturated
+            bool Reserve();
+            void Release();
+            // zeroed sqe tagged with `request`, submitted on the next Submit
+            io_uring_sqe *GetSqe(UringRequest *request);
+            void Submit();
+            // calls `callback` for every completion that is ready
+            template <typename Callback>
+            void Reap(Callback callback);
+
+            int Fd() const { return this->fd; }
+
+        private:
+            Uring() = default;
+
+            int fd = -1;
+            unsigned entries = 0;
+            unsigned active = 0;
+            bool supported[256] = {};
+
+            void *sqRing = nullptr;
+            size_t sqRingSize = 0;
+            void *cqRing = nullptr;
+            size_t cqRingSize = 0;
+            io_uring_sqe *sqes = nullptr;
+            size_t sqesSize = 0;
+
+            unsigned *sqHead = nullptr;
+            unsigned *sqTail = nullptr;
+            unsigned *sqMask = nullptr;
+            unsigned *sqArray = nullptr;
+            unsigned sqLocalTail = 0;
+
+            unsigned *cqHead = nullptr;
+            unsigned *cqTail = nullptr;
+            unsigned *cqMask = nullptr;
+            io_uring_cqe *cqes = nullptr;
+    };
+
+    template <typename Callback>
+    void Uring::Reap(Callback callback) {
+        unsigned head = *this->cqHead;
+
+        while (true) {
+            unsigned tail = __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE);
+            if (head == tail) {
+                break;
+            }
+
+            io_uring_cqe *cqe = &this->cqes[head & *this->cqMask];
+            auto request = (UringRequest *) (uintptr_t) cqe->user_data;
+            int res = cqe->res;
+
+            head++;
+            __atomic_store_n(this->cqHead, head, __ATOMIC_RELEASE);
+
+            callback(request, res);
+        }
+    }
+}
+
+#endif
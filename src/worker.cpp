@@ -0,0 +1,578 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "worker.hpp"
+#include "eventLoop.hpp"
+#include "runtime.hpp"
+#include "v8-array-buffer.h"
+#include "v8-context.h"
+#include "v8-exception.h"
+#include "v8-function.h"
+#include "v8-local-handle.h"
+#include "v8-object.h"
+#include "v8-primitive.h"
+#include "v8-template.h"
+#include "v8-value-serializer.h"
+#include <v8.h>
+
+#include <Senkora.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+extern thread_local const Senkora::SharedGlobals globals;
+
+namespace workers {
+    enum class MessageType {
+        DATA,
+        // parent -> worker, stop the loop
+        TERMINATE,
+        // worker -> parent, the worker's isolate is gone
+        EXIT
+    };
+
+    class Message {
+        public:
+            explicit Message(MessageType type): type(type) {}
+
+            ~Message() {
+                free(this->data);
+            }
+
+            MessageType type;
+            // ValueSerializer output, malloc'd
+            uint8_t *data = nullptr;
+            size_t size = 0;
+            // SharedArrayBuffer ids index into `shared`, transfer ids into `transferred`
+            std::vector<std::shared_ptr<v8::BackingStore>> shared;
+            std::vector<std::shared_ptr<v8::BackingStore>> transferred;
+    };
+
+    // one direction of a worker's channel, the receiving loop watches fd
+    class Port {
+        public:
+            Port() {
+                this->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            }
+
+            ~Port() {
+                close(this->fd);
+            }
+
+            void Send(std::unique_ptr<Message> message) {
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->queue.push_back(std::move(message));
+                }
+
+                uint64_t one = 1;
+                [[maybe_unused]] ssize_t _ = write(this->fd, &one, sizeof(one));
+            }
+
+            void Drain(std::vector<std::unique_ptr<Message>>& out) {
+                uint64_t count;
+                [[maybe_unused]] ssize_t _ = read(this->fd, &count, sizeof(count));
+
+                std::lock_guard<std::mutex> lock(this->mutex);
+                out.swap(this->queue);
+            }
+
+            int Fd() const {
+                return this->fd;
+            }
+
+        private:
+            int fd;
+            std::mutex mutex;
+            std::vector<std::unique_ptr<Message>> queue;
+    };
+
+    // shared by the parent and the worker thread
+    typedef struct {
+        std::string path;
+        Port toWorker;
+        Port toParent;
+        std::mutex mutex;
+        // the worker's isolate while it can still be interrupted
+        v8::Isolate *isolate;
+        bool terminated;
+        std::thread thread;
+    } State;
+
+    // parent side, lives until the worker has exited
+    typedef struct {
+        std::shared_ptr<State> state;
+        v8::Global<v8::Object> object;
+        events::EventLoop *loop;
+    } Handle;
+
+    // worker side, lives on the worker thread's stack
+    typedef struct {
+        std::shared_ptr<State> state;
+        v8::Global<v8::Value> onmessage;
+        events::EventLoop *loop;
+    } Scope;
+
+    thread_local Scope *currentScope = nullptr;
+
+    class SerializerDelegate : public v8::ValueSerializer::Delegate {
+        public:
+            SerializerDelegate(v8::Isolate *isolate, Message *message): isolate(isolate), message(message) {}
+
+            void ThrowDataCloneError(v8::Local<v8::String> error) override {
+                this->isolate->ThrowException(v8::Exception::Error(error));
+            }
+
+            // shared, not copied: the receiving isolate wraps the same store
+            v8::Maybe<uint32_t> GetSharedArrayBufferId([[maybe_unused]] v8::Isolate *isolate, v8::Local<v8::SharedArrayBuffer> buffer) override {
+                std::shared_ptr<v8::BackingStore> store = buffer->GetBackingStore();
+                for (size_t i = 0; i < this->message->shared.size(); i++) {
+                    if (this->message->shared[i].get() == store.get()) {
+                        return v8::Just((uint32_t) i);
+                    }
+                }
+
+                this->message->shared.push_back(std::move(store));
+                return v8::Just((uint32_t) this->message->shared.size() - 1);
+            }
+
+        private:
+            v8::Isolate *isolate;
+            Message *message;
+    };
+
+    class DeserializerDelegate : public v8::ValueDeserializer::Delegate {
+        public:
+            explicit DeserializerDelegate(Message *message): message(message) {}
+
+            v8::MaybeLocal<v8::SharedArrayBuffer> GetSharedArrayBufferFromId(v8::Isolate *isolate, uint32_t id) override {
+                if (id >= this->message->shared.size()) {
+                    return v8::MaybeLocal<v8::SharedArrayBuffer>();
+                }
+
+                return v8::SharedArrayBuffer::New(isolate, this->message->shared[id]);
+            }
+
+        private:
+            Message *message;
+    };
+
+    // nullptr with an exception pending when `value` can't be cloned
+    std::unique_ptr<Message> serialize(v8::Local<v8::Context> ctx, v8::Local<v8::Value> value, v8::Local<v8::Value> transfer) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        auto message = std::make_unique<Message>(MessageType::DATA);
+
+        SerializerDelegate delegate(isolate, message.get());
+        v8::ValueSerializer serializer(isolate, &delegate);
+
+        std::vector<v8::Local<v8::ArrayBuffer>> buffers;
+        if (!transfer->IsUndefined()) {
+            if (!transfer->IsArray()) {
+                Senkora::throwException(ctx, "Expected transfer list to be an array", Senkora::ExceptionType::TYPE);
+                return nullptr;
+            }
+
+            v8::Local<v8::Array> list = transfer.As<v8::Array>();
+            for (uint32_t i = 0; i < list->Length(); i++) {
+                v8::Local<v8::Value> item;
+                if (!list->Get(ctx, i).ToLocal(&item)) {
+                    return nullptr;
+                }
+
+                if (!item->IsArrayBuffer()) {
+                    Senkora::throwException(ctx, "Only ArrayBuffers can be transferred", Senkora::ExceptionType::TYPE);
+                    return nullptr;
+                }
+
+                v8::Local<v8::ArrayBuffer> buffer = item.As<v8::ArrayBuffer>();
+                if (!buffer->IsDetachable()) {
+                    Senkora::throwException(ctx, "ArrayBuffer can't be transferred", Senkora::ExceptionType::TYPE);
+                    return nullptr;
+                }
+
+                for (auto& seen : buffers) {
+                    if (seen == buffer) {
+                        Senkora::throwException(ctx, "ArrayBuffer is listed twice in the transfer list", Senkora::ExceptionType::TYPE);
+                        return nullptr;
+                    }
+                }
+
+                serializer.TransferArrayBuffer((uint32_t) buffers.size(), buffer);
+                buffers.push_back(buffer);
+            }
+        }
+
+        serializer.WriteHeader();
+        if (serializer.WriteValue(ctx, value).IsNothing()) {
+            return nullptr;
+        }
+
+        // the stores move to the message, the sender is left with detached buffers
+        for (auto& buffer : buffers) {
+            message->transferred.push_back(buffer->GetBackingStore());
+            buffer->Detach();
+        }
+
+        std::pair<uint8_t *, size_t> data = serializer.Release();
+        message->data = data.first;
+        message->size = data.second;
+
+        return message;
+    }
+
+    v8::MaybeLocal<v8::Value> deserialize(v8::Local<v8::Context> ctx, Message *message) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+
+        DeserializerDelegate delegate(message);
+        v8::ValueDeserializer deserializer(isolate, message->data, message->size, &delegate);
+
+        for (size_t i = 0; i < message->transferred.size(); i++) {
+            deserializer.TransferArrayBuffer((uint32_t) i, v8::ArrayBuffer::New(isolate, message->transferred[i]));
+        }
+
+        if (deserializer.ReadHeader(ctx).IsNothing()) {
+            return v8::MaybeLocal<v8::Value>();
+        }
+
+        return deserializer.ReadValue(ctx);
+    }
+
+    // calls handler({ data }) with `receiver` as this
+    void dispatch(v8::Local<v8::Context> ctx, v8::Local<v8::Value> handler, v8::Local<v8::Value> receiver, Message *message) {
+        v8::Isolate *isolate = ctx->GetIsolate();
+        if (!handler->IsFunction()) {
+            return;
+        }
+
+        v8::TryCatch tryCatch(isolate);
+
+        v8::Local<v8::Value> data;
+        if (!deserialize(ctx, message).ToLocal(&data)) {
+            if (tryCatch.HasCaught() && !tryCatch.HasTerminated()) {
+                Senkora::printException(ctx, tryCatch.Exception());
+            }
+            return;
+        }
+
+        v8::Local<v8::Object> event = v8::Object::New(isolate);
+        event->Set(ctx, v8::String::NewFromUtf8(isolate, "data").ToLocalChecked(), data).Check();
+
+        v8::Local<v8::Value> argv[] = { event };
+        v8::MaybeLocal<v8::Value> result = handler.As<v8::Function>()->Call(ctx, receiver, 1, argv);
+
+        if (tryCatch.HasTerminated()) {
+            return;
+        }
+
+        if (tryCatch.HasCaught() || result.IsEmpty()) {
+            Senkora::printException(ctx, tryCatch.Exception());
+        }
+    }
+
+    void terminate(State *state) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->terminated) {
+            return;
+        }
+        state->terminated = true;
+
+        // breaks out of running JS, the message wakes an idle loop
+        if (state->isolate != nullptr) {
+            state->isolate->RequestInterrupt([](v8::Isolate *isolate, [[maybe_unused]] void *data) {
+                events::Stop(globals.globalLoop.get());
+                isolate->TerminateExecution();
+            }, nullptr);
+        }
+        state->toWorker.Send(std::make_unique<Message>(MessageType::TERMINATE));
+    }
+
+    /* ---- worker thread ---- */
+
+    void onWorkerMessage([[maybe_unused]] int fd, [[maybe_unused]] uint32_t events, void *data) {
+        Scope *scope = (Scope *) data;
+
+        std::vector<std::unique_ptr<Message>> messages;
+        scope->state->toWorker.Drain(messages);
+        if (messages.empty()) {
+            return;
+        }
+
+        v8::Isolate *isolate = scope->loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope handleScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        for (auto& message : messages) {
+            if (message->type == MessageType::TERMINATE) {
+                events::Stop(scope->loop);
+                return;
+            }
+
+            if (scope->onmessage.IsEmpty() || scope->loop->stopped) {
+                continue;
+            }
+
+            dispatch(ctx, scope->onmessage.Get(isolate), ctx->Global(), message.get());
+        }
+    }
+
+    void threadMain(std::shared_ptr<State> state) {
+        v8::Isolate *isolate = runtime::NewIsolate();
+
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->isolate = isolate;
+        }
+
+        Scope scope;
+        scope.state = state;
+        scope.loop = globals.globalLoop.get();
+        currentScope = &scope;
+
+        {
+            v8::Isolate::Scope isolateScope(isolate);
+            v8::HandleScope handleScope(isolate);
+            v8::Local<v8::Context> ctx = runtime::CreateContext(isolate, true);
+            v8::Context::Scope contextScope(ctx);
+
+            // referenced only while there is an onmessage handler
+            events::Watch(scope.loop, state->toWorker.Fd(), EPOLLIN, onWorkerMessage, &scope, false);
+
+            bool terminated;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                terminated = state->terminated;
+            }
+
+            if (!terminated && runtime::RunModule(ctx, state->path)) {
+                events::Run(scope.loop);
+            }
+
+            events::Shutdown(scope.loop);
+            scope.onmessage.Reset();
+        }
+
+        currentScope = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->isolate = nullptr;
+        }
+        isolate->Dispose();
+
+        state->toParent.Send(std::make_unique<Message>(MessageType::EXIT));
+    }
+
+    void postMessageFromWorker(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        std::unique_ptr<Message> message = serialize(ctx, args[0], args[1]);
+        if (!message) {
+            return;
+        }
+
+        currentScope->state->toParent.Send(std::move(message));
+    }
+
+    void closeWorker([[maybe_unused]] const v8::FunctionCallbackInfo<v8::Value>& args) {
+        events::Stop(currentScope->loop);
+    }
+
+    void getOnMessage([[maybe_unused]] v8::Local<v8::String> property, const v8::PropertyCallbackInfo<v8::Value>& info) {
+        if (currentScope->onmessage.IsEmpty()) {
+            info.GetReturnValue().SetNull();
+            return;
+        }
+
+        info.GetReturnValue().Set(currentScope->onmessage.Get(info.GetIsolate()));
+    }
+
+    // a worker with a message handler stays alive waiting for messages,
+    // clearing the handler lets it exit once nothing else is pending
+    void setOnMessage([[maybe_unused]] v8::Local<v8::String> property, v8::Local<v8::Value> value, [[maybe_unused]] const v8::PropertyCallbackInfo<void>& info) {
+        bool handler = value->IsFunction();
+        if (handler) {
+            currentScope->onmessage.Reset(info.GetIsolate(), value);
+        } else {
+            currentScope->onmessage.Reset();
+        }
+
+        events::SetRef(currentScope->loop, currentScope->state->toWorker.Fd(), handler);
+    }
+
+    /* ---- parent thread ---- */
+
+    void onParentMessage([[maybe_unused]] int fd, [[maybe_unused]] uint32_t events, void *data) {
+        Handle *handle = (Handle *) data;
+
+        std::vector<std::unique_ptr<Message>> messages;
+        handle->state->toParent.Drain(messages);
+        if (messages.empty()) {
+            return;
+        }
+
+        v8::Isolate *isolate = handle->loop->isolate;
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::HandleScope handleScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        v8::Local<v8::Object> object = handle->object.Get(isolate);
+
+        for (auto& message : messages) {
+            if (message->type == MessageType::EXIT) {
+                handle->state->thread.join();
+                events::Unwatch(handle->loop, handle->state->toParent.Fd());
+
+                Senkora::setNativePointer(object, Senkora::NativeType::WORKER, nullptr);
+                handle->object.Reset();
+                delete handle;
+                return;
+            }
+
+            v8::Local<v8::Value> handler;
+            if (!object->Get(ctx, v8::String::NewFromUtf8(isolate, "onmessage").ToLocalChecked()).ToLocal(&handler)) {
+                continue;
+            }
+
+            dispatch(ctx, handler, object, message.get());
+        }
+    }
+
+    Handle *getHandle(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        return (Handle *) Senkora::getNativePointer(args.This(), Senkora::NativeType::WORKER);
+    }
+
+    void constructWorker(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (!args.IsConstructCall()) {
+            Senkora::throwException(ctx, "Worker constructor requires 'new'", Senkora::ExceptionType::TYPE);
+            return;
+        }
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        if (!args[0]->IsString()) {
+            Senkora::throwException(ctx, "Expected argument 1 to be a string");
+            return;
+        }
+
+        v8::String::Utf8Value pathUtf8(isolate, args[0]);
+        std::string path = *pathUtf8;
+        if (path[0] != '/') {
+            path = std::filesystem::path(std::filesystem::current_path().string() + "/" + path).lexically_normal();
+        }
+
+        auto state = std::make_shared<State>();
+        state->path = path;
+        state->isolate = nullptr;
+        state->terminated = false;
+
+        auto handle = new Handle();
+        handle->state = state;
+        handle->loop = globals.globalLoop.get();
+        handle->object.Reset(isolate, args.This());
+        Senkora::setNativePointer(args.This(), Senkora::NativeType::WORKER, handle);
+
+        // keeps the parent alive until the worker has exited
+        events::Watch(handle->loop, state->toParent.Fd(), EPOLLIN, onParentMessage, handle);
+        state->thread = std::thread(threadMain, state);
+    }
+
+    void postMessageToWorker(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        v8::Isolate *isolate = args.GetIsolate();
+        v8::Isolate::Scope isolateScope(isolate);
+        v8::Local<v8::Context> ctx = isolate->GetCurrentContext();
+        v8::Context::Scope contextScope(ctx);
+
+        if (args.Length() < 1) {
+            Senkora::throwException(ctx, "Expected 1 argument");
+            return;
+        }
+
+        Handle *handle = getHandle(args);
+        std::unique_ptr<Message> message = serialize(ctx, args[0], args[1]);
+        if (!message || handle == nullptr) {
+            return;
+        }
+
+        handle->state->toWorker.Send(std::move(message));
+    }
+
+    void terminateWorker(const v8::FunctionCallbackInfo<v8::Value>& args) {
+        Handle *handle = getHandle(args);
+        if (handle == nullptr) {
+            return;
+        }
+
+        terminate(handle->state.get());
+    }
+
+    void Init(v8::Isolate *isolate, v8::Local<v8::ObjectTemplate> global) {
+        v8::Local<v8::FunctionTemplate> worker = v8::FunctionTemplate::New(isolate, constructWorker);
+        worker->SetClassName(v8::String::NewFromUtf8(isolate, "Worker").ToLocalChecked());
+        worker->InstanceTemplate()->SetInternalFieldCount(Senkora::NATIVE_FIELD_COUNT);
+
+        v8::Local<v8::ObjectTemplate> proto = worker->PrototypeTemplate();
+        proto->Set(isolate, "postMessage", v8::FunctionTemplate::New(isolate, postMessageToWorker));
+        proto->Set(isolate, "terminate", v8::FunctionTemplate::New(isolate, terminateWorker));
+
+        global->Set(isolate, "Worker", worker);
+    }
+
+    void InitScope(v8::Isolate *isolate, v8::Local<v8::ObjectTemplate> global) {
+        global->Set(isolate, "postMessage", v8::FunctionTemplate::New(isolate, postMessageFromWorker));
+        global->Set(isolate, "close", v8::FunctionTemplate::New(isolate, closeWorker));
+        global->SetAccessor(v8::String::NewFromUtf8(isolate, "onmessage").ToLocalChecked(), getOnMessage, setOnMessage);
+    }
+
+    void ExternalReferences(std::vector<intptr_t>& refs) {
+        refs.insert(refs.end(), {
+            reinterpret_cast<intptr_t>(constructWorker),
+            reinterpret_cast<intptr_t>(postMessageToWorker),
+            reinterpret_cast<intptr_t>(terminateWorker),
+            reinterpret_cast<intptr_t>(postMessageFromWorker),
+            reinterpret_cast<intptr_t>(closeWorker),
+            reinterpret_cast<intptr_t>(getOnMessage),
+            reinterpret_cast<intptr_t>(setOnMessage),
+        });
+    }
+}
@@ -0,0 +1,36 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef WORKER_HPP
+#define WORKER_HPP
+
+#include <v8.h>
+#include <cstdint>
+#include <vector>
+
+// Each Worker runs a module on its own thread with its own isolate and
+// event loop, messages are structured clones made with ValueSerializer.
+namespace workers {
+    // the Worker constructor
+    void Init(v8::Isolate *isolate, v8::Local<v8::ObjectTemplate> global);
+    // postMessage, onmessage and close inside a worker
+    void InitScope(v8::Isolate *isolate, v8::Local<v8::ObjectTemplate> global);
+    // the callbacks of Init and InitScope, for the startup snapshot
+    void ExternalReferences(std::vector<intptr_t>& refs);
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+import { writeToFile, readFromFile, exists, existsFile, existsDirectory, deleteFile, deleteDirectory, createDirectory, statMany, readMany, copyFile } from "senkora:fs/promises";
+import { expect, describe, test } from "senkora:test";
+
+const str = "Hello, Senkora!";
+const date = new Date().toISOString().replaceAll(":", "_");
+const fname = "/tmp/senkora_promises_test-" + date + ".txt";
+const dname = "/tmp/senkora_promises_test-" + date;
+
+describe("fs/promises", () => {
+    test("writeToFile()", async () => {
+        const file = fname + ".write";
+        await writeToFile(file, str);
+        expect(await existsFile(file)).toBeTrue();
+        await deleteFile(file);
+    });
+
+    test("readFromFile()", async () => {
+        const file = fname + ".read";
+        await writeToFile(file, str);
+        expect(await readFromFile(file)).toEqual(str);
+        await deleteFile(file);
+    });
+
+    test("readFromFile() - Large File", async () => {
+        const file = fname + ".large";
+        await writeToFile(file, str.repeat(100000));
+        expect(await readFromFile(file)).toEqual(str.repeat(100000));
+        await deleteFile(file);
+    });
+
+    test("readFromFile() - Missing", async () => {
+        let failed = false;
+        await readFromFile(fname + ".missing").catch(() => failed = true);
+        expect(failed).toBeTrue();
+    });
+
+    test("exists()", async () => {
+        const file = fname + ".exists";
+        await writeToFile(file, str);
+        expect(await exists(file)).toBeTrue();
+        expect(await exists("/tmp")).toBeTrue();
+        expect(await exists(file + "a")).toBeFalse();
+        await deleteFile(file);
+    });
+
+    test("existsFile() / existsDirectory()", async () => {
+        const file = fname + ".kind";
+        await writeToFile(file, str);
+        expect(await existsFile("/tmp")).toBeFalse();
+        expect(await existsDirectory("/tmp")).toBeTrue();
+        expect(await existsDirectory(file)).toBeFalse();
+        await deleteFile(file);
+    });
+
+    test("createDirectory() / deleteDirectory()", async () => {
+        await createDirectory(dname);
+        await writeToFile(dname + "/test.txt", "Senkora");
+        for (let i = 0; i < 20; i++) {
+            await createDirectory(dname + "/sub" + i);
+            await writeToFile(dname + "/sub" + i + "/test.txt", "Senkora");
+        }
+        expect(await existsDirectory(dname)).toBeTrue();
+        await deleteDirectory(dname);
+        expect(await exists(dname)).toBeFalse();
+    });
+
+    test("Concurrent", async () => {
+        const names = [];
+        for (let i = 0; i < 64; i++) {
+            names.push(fname + "." + i);
+        }
+        await Promise.all(names.map((name, i) => writeToFile(name, str + i)));
+        const data = await Promise.all(names.map(name => readFromFile(name)));
+        data.forEach((value, i) => expect(value).toEqual(str + i));
+        await Promise.all(names.map(name => deleteFile(name)));
+    });
+
+    test("statMany() / readMany()", async () => {
+        const file = fname + ".many";
+        await writeToFile(file, str);
+        const stats = await statMany([file, "/tmp", file + ".missing"]);
+        expect(Array.from(stats.kind)).toEqual([1, 2, 0]);
+        expect(stats.size[0]).toEqual(str.length);
+
+        const files = await readMany([file, file + ".missing"]);
+        expect(files[0].length).toEqual(str.length);
+        expect(files[1]).toEqual(null);
+        await deleteFile(file);
+    });
+
+    test("copyFile()", async () => {
+        const file = fname + ".source";
+        await writeToFile(file, str);
+        await copyFile(file, file + ".copy");
+        expect(await readFromFile(file + ".copy")).toEqual(str);
+        await deleteFile(file + ".copy");
+        await deleteFile(file);
+    });
+
+    test("deleteFile()", async () => {
+        const file = fname + ".delete";
+        await writeToFile(file, str);
+        await deleteFile(file);
+        expect(await exists(file)).toBeFalse();
+    });
+});
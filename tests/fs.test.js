@@ -15,7 +15,7 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
-import { writeToFile, readFromFile, exists, existsFile, existsDirectory, deleteFile, deleteDirectory, createDirectory } from "senkora:fs";
+import { writeToFile, readFromFile, readFileBytes, createReadStream, readLines, grep, readDir, walk, watch, statMany, readMany, copyFile, copyDirectory, open, exists, existsFile, existsDirectory, deleteFile, deleteDirectory, createDirectory } from "senkora:fs";
 import { expect, describe, test } from "senkora:test";
 
 const str = "Hello, Senkora!";
@@ -81,6 +81,395 @@ describe("fs - Advanced", () => {
         };
     });
 
+    test("readFromFile() - Missing File", () => {
+        let failed = false;
+        try {
+            readFromFile(fname + ".missing");
+        } catch (e) {
+            failed = true;
+        }
+        expect(failed).toBeTrue();
+    });
+
+    test("readFromFile() - Special File", () => {
+        expect(readFromFile("/proc/self/status").length > 0).toBeTrue();
+    });
+
+    test("writeToFile() - Binary", () => {
+        writeToFile(fname, new Uint8Array([72, 0, 105]));
+        const bytes = readFileBytes(fname);
+        expect(bytes.length).toEqual(3);
+        expect(bytes[1]).toEqual(0);
+
+        writeToFile(fname, new Uint8Array([1, 2, 3, 4]).buffer);
+        expect(readFileBytes(fname).length).toEqual(4);
+    });
+
+    test("writeToFile() - Append and chunks", () => {
+        writeToFile(fname, "Hello");
+        writeToFile(fname, ", Senkora!", { append: true });
+        expect(readFromFile(fname)).toEqual(str);
+
+        writeToFile(fname, ["Hello", new Uint8Array([44, 32]), "Senkora!"]);
+        expect(readFromFile(fname)).toEqual(str);
+    });
+
+    test("writeToFile() - Detaching getters", () => {
+        const file = fname + ".detach";
+        const worker = new Worker(import.meta.url.replace(/[^/]*$/, "workerEcho.js"));
+
+        // a getter that runs after the first chunk was seen hands its buffer away
+        const first = new Uint8Array(1024 * 1024).fill(65);
+        const chunks = [first];
+        Object.defineProperty(chunks, 1, { get() { worker.postMessage(null, [first.buffer]); return "tail"; } });
+        writeToFile(file, chunks);
+        expect(first.byteLength).toEqual(0);
+        expect(readFromFile(file)).toEqual("tail");
+
+        const second = new Uint8Array(1024 * 1024).fill(66);
+        writeToFile(file, [second, "tail"], { get append() { worker.postMessage(null, [second.buffer]); return false; } });
+        expect(second.byteLength).toEqual(0);
+        expect(readFromFile(file)).toEqual("tail");
+
+        worker.terminate();
+        deleteFile(file);
+    });
+
+    test("readFileBytes()", () => {
+        writeToFile(fname, str);
+        const bytes = readFileBytes(fname);
+        expect(bytes instanceof Uint8Array).toBeTrue();
+        expect(bytes.length).toEqual(str.length);
+        expect(bytes[0]).toEqual("H".charCodeAt(0));
+
+        // copy-on-write, the file keeps its content
+        bytes[0] = 0;
+        expect(readFromFile(fname)).toEqual(str);
+
+        writeToFile(fname, "");
+        expect(readFileBytes(fname).length).toEqual(0);
+        expect(readFileBytes("/proc/self/status").length > 0).toBeTrue();
+    });
+
+    test("createReadStream()", async () => {
+        const file = fname + ".stream";
+        writeToFile(file, new Uint8Array(200000).fill(7));
+
+        let total = 0;
+        let chunks = 0;
+        for await (const chunk of createReadStream(file, { chunkSize: 65536 })) {
+            expect(chunk instanceof Uint8Array).toBeTrue();
+            expect(chunk[chunk.length - 1]).toEqual(7);
+            total += chunk.length;
+            chunks++;
+        }
+        expect(total).toEqual(200000);
+        expect(chunks).toEqual(4);
+
+        deleteFile(file);
+    });
+
+    test("createReadStream() - Early exit", async () => {
+        const file = fname + ".early";
+        writeToFile(file, new Uint8Array(200000).fill(7));
+
+        let chunks = 0;
+        for await (const chunk of createReadStream(file, { chunkSize: 1024 })) {
+            chunks++;
+            break;
+        }
+        expect(chunks).toEqual(1);
+
+        deleteFile(file);
+    });
+
+    test("readLines()", async () => {
+        const expected = [];
+        for (let i = 0; i < 5000; i++) {
+            expected.push("line " + i + " " + "x".repeat(i % 97));
+        }
+        const file = fname + ".lines";
+        writeToFile(file, expected.join("\n") + "\r\nlast");
+        expected.push("last");
+
+        const lines = [];
+        for await (const batch of readLines(file, { batchSize: 300 })) {
+            expect(batch.length <= 300).toBeTrue();
+            lines.push(...batch);
+        }
+        expect(lines.length).toEqual(5001);
+        expect(lines[1234]).toEqual(expected[1234]);
+        expect(lines[4999]).toEqual(expected[4999]);
+        expect(lines[5000]).toEqual("last");
+
+        writeToFile(file, "");
+        let batches = 0;
+        for await (const batch of readLines(file)) {
+            batches++;
+        }
+        expect(batches).toEqual(0);
+
+        deleteFile(file);
+    });
+
+    test("grep()", async () => {
+        const lines = [];
+        for (let i = 0; i < 100000; i++) {
+            lines.push(i % 10000 == 42 ? "ERROR at " + i + ", ERROR again" : "ok " + i);
+        }
+        const file = fname + ".grep";
+        writeToFile(file, lines.join("\n"));
+
+        const matches = await grep([file, file + ".missing"], "ERROR");
+        expect(matches.length).toEqual(10);
+        expect(matches[0].path).toEqual(file);
+        expect(matches[0].line).toEqual("ERROR at 42, ERROR again");
+        expect(matches[0].offset).toEqual(lines.slice(0, 42).join("\n").length + 1);
+        expect(matches[9].line).toEqual("ERROR at 90042, ERROR again");
+
+        const first = await grep(file, "ERROR", { maxMatches: 3 });
+        expect(first.length).toEqual(3);
+        expect(first[2].line).toEqual("ERROR at 20042, ERROR again");
+
+        expect((await grep(file, "missing")).length).toEqual(0);
+
+        deleteFile(file);
+    });
+
+    test("grep() - Long line", async () => {
+        // one line across three 4 MiB chunks, found from two of them
+        const long = "x".repeat(5 * 1024 * 1024);
+        const file = fname + ".long";
+        writeToFile(file, "first\n" + long + "needle" + long + "needle\nlast\n");
+
+        const matches = await grep(file, "needle");
+        expect(matches.length).toEqual(1);
+        expect(matches[0].offset).toEqual(6);
+        expect(matches[0].line.length).toEqual(long.length * 2 + 12);
+
+        deleteFile(file);
+    });
+
+    test("readDir()", () => {
+        const tmp = "/tmp/senkora_test-" + date + "-dir";
+        createDirectory(tmp);
+        createDirectory(tmp + "/sub");
+        writeToFile(tmp + "/a.txt", "a");
+
+        const entries = readDir(tmp).sort((a, b) => a.name < b.name ? -1 : 1);
+        expect(entries.length).toEqual(2);
+        expect(entries[0]).toEqual({ name: "a.txt", type: "file" });
+        expect(entries[1]).toEqual({ name: "sub", type: "directory" });
+
+        deleteDirectory(tmp);
+    });
+
+    test("walk()", async () => {
+        const tmp = "/tmp/senkora_test-" + date + "-walk";
+        createDirectory(tmp);
+        for (let i = 0; i < 10; i++) {
+            createDirectory(tmp + "/d" + i);
+            for (let j = 0; j < 10; j++) {
+                writeToFile(tmp + "/d" + i + "/f" + j, "");
+            }
+        }
+
+        const paths = [];
+        for await (const batch of walk(tmp, { batchSize: 7 })) {
+            expect(batch.length <= 7).toBeTrue();
+            batch.forEach(entry => paths.push(entry.path));
+        }
+        expect(paths.length).toEqual(110);
+        expect(paths.includes(tmp + "/d3/f4")).toBeTrue();
+
+        let shallow = 0;
+        for await (const batch of walk(tmp, { maxDepth: 0 })) {
+            shallow += batch.length;
+        }
+        expect(shallow).toEqual(10);
+
+        deleteDirectory(tmp);
+    });
+
+    test("statMany()", () => {
+        const paths = [fname, "/tmp", fname + ".missing"];
+        for (let i = 0; i < 1000; i++) {
+            paths.push(fname);
+        }
+        writeToFile(fname, str);
+
+        const stats = statMany(paths);
+        expect(stats.size instanceof Float64Array).toBeTrue();
+        expect(stats.kind.length).toEqual(paths.length);
+        expect(stats.kind[0]).toEqual(1); // file
+        expect(stats.kind[1]).toEqual(2); // directory
+        expect(stats.kind[2]).toEqual(0); // missing
+        expect(stats.kind[1002]).toEqual(1);
+        expect(stats.size[1002]).toEqual(str.length);
+        expect(stats.mtime[0] > 0).toBeTrue();
+        expect((stats.mode[1] & 0o170000) == 0o040000).toBeTrue();
+    });
+
+    test("readMany()", () => {
+        writeToFile(fname, str);
+        const files = readMany([fname, fname + ".missing", "/proc/self/status"]);
+        expect(files.length).toEqual(3);
+        expect(files[0].length).toEqual(str.length);
+        expect(files[0][0]).toEqual("H".charCodeAt(0));
+        expect(files[1]).toEqual(null);
+        expect(files[2].length > 0).toBeTrue();
+    });
+
+    test("copyFile()", () => {
+        const bytes = new Uint8Array(300000).map((_, i) => i % 251);
+        writeToFile(fname, bytes);
+        copyFile(fname, fname + ".copy");
+
+        const copy = readFileBytes(fname + ".copy");
+        expect(copy.length).toEqual(bytes.length);
+        expect(copy[1000]).toEqual(1000 % 251);
+
+        let failed = false;
+        try {
+            copyFile(fname, fname + ".copy", { overwrite: false });
+        } catch (e) {
+            failed = true;
+        }
+        expect(failed).toBeTrue();
+
+        // a copy that fails halfway leaves the file it would replace alone
+        failed = false;
+        try {
+            copyFile("/proc/self/mem", fname + ".copy");
+        } catch (e) {
+            failed = true;
+        }
+        expect(failed).toBeTrue();
+        expect(readFileBytes(fname + ".copy").length).toEqual(bytes.length);
+        deleteFile(fname + ".copy");
+    });
+
+    test("copyDirectory()", () => {
+        const tmp = "/tmp/senkora_test-" + date + "-copy";
+        createDirectory(tmp);
+        createDirectory(tmp + "/sub");
+        for (let i = 0; i < 20; i++) {
+            writeToFile(tmp + "/sub/f" + i, "Senkora " + i);
+        }
+
+        copyDirectory(tmp, tmp + "-to");
+        expect(readDir(tmp + "-to/sub").length).toEqual(20);
+        expect(readFromFile(tmp + "-to/sub/f7")).toEqual("Senkora 7");
+
+        deleteDirectory(tmp);
+        deleteDirectory(tmp + "-to");
+    });
+
+    test("open()", () => {
+        const file = open(fname, "w+");
+        expect(file.write("Hello, ")).toEqual(7);
+        expect(file.writev(["Senkora", new Uint8Array([33])])).toEqual(8);
+        expect(file.write("J", 0)).toEqual(1);
+        file.fsync();
+
+        const buf = new Uint8Array(7);
+        expect(file.read(buf, 7)).toEqual(7);
+        expect(String.fromCharCode(...buf)).toEqual("Senkora");
+
+        const head = new Uint8Array(5);
+        const tail = new Uint8Array(10);
+        expect(file.readv([head, tail], 0)).toEqual(15);
+        expect(String.fromCharCode(...head)).toEqual("Jello");
+        expect(file.read(buf, 15)).toEqual(0);
+        file.close();
+
+        let failed = false;
+        try {
+            file.read(buf, 0);
+        } catch (e) {
+            failed = true;
+        }
+        expect(failed).toBeTrue();
+
+        const reader = open(fname);
+        expect(reader.read(buf)).toEqual(7);
+        expect(reader.read(buf)).toEqual(7);
+        expect(String.fromCharCode(...buf)).toEqual("Senkora");
+
+        // a valueOf() could detach the buffer, offsets have to be numbers
+        let rejected = false;
+        try {
+            reader.read(buf, { valueOf() { return 0; } });
+        } catch (e) {
+            rejected = true;
+        }
+        expect(rejected).toBeTrue();
+        reader.close();
+    });
+
+    test("watch()", async () => {
+        const tmp = "/tmp/senkora_test-" + date + "-watch";
+        createDirectory(tmp);
+        createDirectory(tmp + "/sub");
+
+        const seen = [];
+        let changed;
+        const watcher = watch(tmp, { recursive: true }, events => {
+            seen.push(...events);
+            changed();
+        });
+
+        await new Promise(resolve => {
+            changed = resolve;
+            writeToFile(tmp + "/a.txt", "a");
+            writeToFile(tmp + "/a.txt", "b");
+        });
+        // both writes land in one batch, each path once per type
+        expect(seen.filter(e => e.path == "a.txt" && e.type == "change").length).toEqual(1);
+        expect(seen.some(e => e.path == "a.txt" && e.type == "rename")).toBeTrue();
+
+        await new Promise(resolve => {
+            changed = resolve;
+            writeToFile(tmp + "/sub/b.txt", "b");
+        });
+        expect(seen.some(e => e.path == "sub/b.txt")).toBeTrue();
+
+        watcher.close();
+        deleteDirectory(tmp);
+    });
+
+    test("Native methods check their receiver", () => {
+        const file = fname + ".receiver";
+        writeToFile(file, "receiver");
+
+        const handle = open(file, "r+");
+        const lines = readLines(file);
+        const watcher = watch(file, () => {});
+        const worker = new Worker(import.meta.url.replace(/[^/]*$/, "workerEcho.js"));
+
+        // none of these may treat the other object's struct as its own
+        watcher.close.call(handle);
+        watcher.close.call(lines);
+        worker.terminate.call(watcher);
+        expect(handle.write("R", 0)).toEqual(1);
+
+        let failures = 0;
+        for (const call of [() => handle.read.call(watcher, new Uint8Array(1)), () => handle.close.call(worker), () => lines.next.call(handle)]) {
+            try {
+                call();
+            } catch (e) {
+                failures++;
+            }
+        }
+        expect(failures).toEqual(3);
+
+        watcher.close();
+        worker.terminate();
+        lines.return();
+        handle.close();
+        deleteFile(file);
+    });
+
     test("deleteDirectory() - Recursive", () => {
         const tmp = "/tmp/senkora_test-" + date;
         createDirectory(tmp);
@@ -91,6 +480,46 @@ describe("fs - Advanced", () => {
         expect(existsDirectory(tmp)).toBeFalse();
         expect(existsFile(tmp + "/test.txt")).toBeFalse();
     });
+
+    test("deleteDirectory() - Wide", () => {
+        // more directories than a default fd limit, each waiting on a subdirectory
+        const tmp = "/tmp/senkora_test-" + date + "-wide";
+        createDirectory(tmp);
+        for (let i = 0; i < 3000; i++) {
+            createDirectory(tmp + "/d" + i);
+            createDirectory(tmp + "/d" + i + "/sub");
+        }
+
+        deleteDirectory(tmp);
+        expect(existsDirectory(tmp)).toBeFalse();
+    });
+
+    test("deleteDirectory() - Symlinks", () => {
+        const tmp = "/tmp/senkora_test-" + date + "-links";
+        createDirectory(tmp);
+        createDirectory(tmp + "/target");
+        writeToFile(tmp + "/target/keep.txt", "keep");
+
+        // /proc/self/fd holds a symlink to every open file, the handle
+        // adds one to the target directory
+        const dir = open(tmp + "/target");
+        copyDirectory("/proc/self/fd", tmp + "/links");
+        dir.close();
+
+        const links = readDir(tmp + "/links");
+        expect(links.every(entry => entry.type === "symlink")).toBeTrue();
+
+        // a symlinked root is unlinked, not followed
+        deleteDirectory(tmp + "/links/" + links[0].name);
+        expect(readDir(tmp + "/links").length).toEqual(links.length - 1);
+
+        deleteDirectory(tmp + "/links");
+        expect(existsDirectory(tmp + "/links")).toBeFalse();
+        expect(existsFile(tmp + "/target/keep.txt")).toBeTrue();
+
+        deleteDirectory(tmp);
+        expect(existsDirectory(tmp)).toBeFalse();
+    });
 });
 
 describe("Cleanup", () => {
@@ -0,0 +1,80 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+import { expect, describe, test } from "senkora:test";
+
+describe("scheduler", () => {
+    test("postTask() resolves with the callback's result", async () => {
+        expect(await scheduler.postTask(() => 42)).toEqual(42);
+    });
+
+    test("postTask() rejects when the callback throws", async () => {
+        let failed = false;
+        await scheduler.postTask(() => { throw new Error("boom"); }).catch(() => failed = true);
+        expect(failed).toBeTrue();
+    });
+
+    test("Priority order", async () => {
+        const order = [];
+        await Promise.all([
+            scheduler.postTask(() => order.push("background"), { priority: "background" }),
+            scheduler.postTask(() => order.push("user-visible")),
+            scheduler.postTask(() => order.push("user-blocking"), { priority: "user-blocking" }),
+        ]);
+        expect(order).toEqual(["user-blocking", "user-visible", "background"]);
+    });
+
+    test("yield() continues ahead of queued tasks", async () => {
+        const order = [];
+        await Promise.all([
+            scheduler.postTask(async () => {
+                order.push("first");
+                await scheduler.yield();
+                order.push("continuation");
+            }),
+            scheduler.postTask(() => order.push("second")),
+        ]);
+        expect(order).toEqual(["first", "continuation", "second"]);
+    });
+
+    test("yield() keeps the priority of a background task", async () => {
+        const order = [];
+        const visible = [];
+        await scheduler.postTask(async () => {
+            order.push("b1");
+            visible.push(scheduler.postTask(() => order.push("u1")));
+            await scheduler.yield();
+            // resumed from a microtask, still a background task
+            order.push("b2");
+            visible.push(scheduler.postTask(() => order.push("u2")));
+            await scheduler.yield();
+            order.push("b3");
+        }, { priority: "background" });
+        await Promise.all(visible);
+        expect(order).toEqual(["b1", "u1", "b2", "u2", "b3"]);
+    });
+
+    test("Invalid priority", () => {
+        let failed = false;
+        try {
+            scheduler.postTask(() => {}, { priority: "urgent" });
+        } catch (e) {
+            failed = true;
+        }
+        expect(failed).toBeTrue();
+    });
+});
@@ -37,4 +37,20 @@ describe("Senkora", () => {
         const [ret, err] = Senkora.peekaboo(prom);
         expect([ret, err]).toEqual([undefined, new SenkoraError("Promise is not Fulfilled")]);
     });
+    test("loopStats", () => {
+        const stats = Senkora.loopStats();
+        expect(stats.ticks).toEqual(0);
+        expect(stats.tickDuration).toBeObject();
+        expect(stats.lag).toBeObject();
+        expect(stats.pendingTimers).toEqual(0);
+        expect(stats.idleGcTime).toEqual(0);
+    });
+    test("globals", () => {
+        // these come out of the startup snapshot when there is one
+        expect(Senkora.isWorker).toEqual(false);
+        expect(typeof Worker).toEqual("function");
+        expect(typeof scheduler.postTask).toEqual("function");
+        expect(typeof console.log).toEqual("function");
+        expect(typeof postMessage).toEqual("undefined");
+    });
 });
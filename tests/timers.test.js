@@ -0,0 +1,90 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+import { expect, describe, test } from "senkora:test";
+
+const sleep = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+describe("timers", () => {
+    test("clearTimeout()", async () => {
+        let fired = false;
+        const id = setTimeout(() => { fired = true; }, 5);
+        clearTimeout(id);
+        await sleep(20);
+        expect(fired).toBeFalse();
+    });
+
+    test("setTimeout() order", async () => {
+        const order = [];
+        setTimeout(() => order.push(3), 30);
+        setTimeout(() => order.push(1), 10);
+        setTimeout(() => order.push(2), 20);
+        await sleep(50);
+        expect(order).toEqual([1, 2, 3]);
+    });
+
+    test("clearInterval()", async () => {
+        let runs = 0;
+        const id = setInterval(() => {
+            runs++;
+            if (runs === 3) clearInterval(id);
+        }, 1);
+        await sleep(50);
+        expect(runs).toEqual(3);
+    });
+
+    test("clear inside the same tick", async () => {
+        let fired = false;
+        let second;
+        setTimeout(() => clearTimeout(second), 5);
+        second = setTimeout(() => { fired = true; }, 5);
+        await sleep(20);
+        expect(fired).toBeFalse();
+    });
+
+    test("stale ids don't clear recycled timers", async () => {
+        const stale = setTimeout(() => {}, 1);
+        await sleep(10);
+        let fired = false;
+        setTimeout(() => { fired = true; }, 1);
+        clearTimeout(stale);
+        await sleep(10);
+        expect(fired).toBeTrue();
+    });
+
+    test("clearTimeout(0) doesn't release a free slot", async () => {
+        setTimeout(() => {}, 1);
+        await sleep(10);
+        clearTimeout(0);
+        clearInterval(0);
+        const fired = [];
+        setTimeout(() => fired.push(1), 1);
+        setTimeout(() => fired.push(2), 2);
+        await sleep(20);
+        expect(fired).toEqual([1, 2]);
+    });
+
+    test("queueMicrotask() runs before the next macrotask", async () => {
+        const order = [];
+        setImmediate(() => order.push("immediate"));
+        queueMicrotask(() => order.push("microtask"));
+        Promise.resolve().then(() => order.push("promise"));
+        order.push("sync");
+        await sleep(10);
+        expect(order).toEqual(["sync", "microtask", "promise", "immediate"]);
+    });
+});
@@ -0,0 +1,63 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+import { expect, describe, test } from "senkora:test";
+
+const echo = import.meta.url.replace(/[^/]*$/, "workerEcho.js");
+
+function roundTrip(worker, message, transfer) {
+    return new Promise((resolve) => {
+        worker.onmessage = (event) => resolve(event.data);
+        worker.postMessage(message, transfer);
+    });
+}
+
+describe("Worker", () => {
+    test("Structured clone", async () => {
+        const worker = new Worker(echo);
+        const data = await roundTrip(worker, { a: 1, b: [1, 2, 3], c: "Senkora", d: new Map([[1, 2]]) });
+        expect(data.a).toEqual(1);
+        expect(data.b.length).toEqual(3);
+        expect(data.c).toEqual("Senkora");
+        expect(data.d.get(1)).toEqual(2);
+        worker.terminate();
+    });
+
+    test("Transferred ArrayBuffer is detached", async () => {
+        const worker = new Worker(echo);
+        const buffer = new Uint8Array([7, 8, 9]).buffer;
+        const data = await roundTrip(worker, { buffer }, [buffer]);
+        expect(buffer.byteLength).toEqual(0);
+        expect(data.length).toEqual(3);
+        expect(data.first).toEqual(7);
+        worker.terminate();
+    });
+
+    test("SharedArrayBuffer is shared", async () => {
+        const worker = new Worker(echo);
+        const shared = new SharedArrayBuffer(4);
+        await roundTrip(worker, { shared });
+        await roundTrip(worker, { shared });
+        expect(new Int32Array(shared)[0]).toEqual(2);
+        worker.terminate();
+    });
+
+    test("Isolated globals", () => {
+        expect(Senkora.isWorker).toBeFalse();
+        expect(typeof postMessage).toEqual("undefined");
+    });
+});
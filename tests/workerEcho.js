@@ -0,0 +1,33 @@
+/*
+Senkora - JS runtime for the modern age
+Copyright (C) 2023  SenkoraJS
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// Worker used by worker.test.js, echoes what it gets and bumps shared counters
+onmessage = (event) => {
+    const data = event.data;
+    if (data.shared) {
+        Atomics.add(new Int32Array(data.shared), 0, 1);
+    }
+    if (data.buffer) {
+        postMessage({ length: data.buffer.byteLength, first: new Uint8Array(data.buffer)[0] });
+        return;
+    }
+    if (data.close) {
+        close();
+        return;
+    }
+    postMessage(data);
+};